@@ -5,6 +5,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <vector>
 #include <string>
 // 在gl和glfw3之前包含glew
@@ -23,6 +26,26 @@
 #include "common/loadShader.h" // 加载着色器
 #include "common/BMPlib.h"     // BMP格式读取
 #include "common/texture.hpp"  // DDS格式纹理解析
+#include "common/heightfield.hpp"    // 16位/浮点高度图
+#include "common/terrain_index.hpp"  // 地形索引生成
+#include "common/terrain_mesh.hpp"   // 地形网格生成
+#include "common/terrain_geomip.hpp" // 几何mipmap LOD
+#include "common/terrain_cdlod.hpp"  // CDLOD四叉树LOD
+#include "common/terrain_clipmap.hpp" // 几何clipmap
+#include "common/terrain_cull.hpp"    // 分块视锥剔除
+#include "common/terrain_horizon.hpp" // 地平线遮挡剔除
+#include "common/soft_occlusion.hpp"  // 软件深度缓冲遮挡剔除
+#include "common/terrain_normals.hpp" // 法线图（八面体编码）
+#include "common/terrain_tiles.hpp"   // 分块高度图文件（.thf）
+#include "common/terrain_stream.hpp"  // 分块异步流式加载
+#include "common/stream_buffer.hpp"   // 每帧上传用的环形缓冲
+#include "common/terrain_multidraw.hpp" // 分块合并为一次multi-draw提交
+#include "common/camera_path.hpp"     // 相机路径回放
+#include "common/frame_report.hpp"    // 逐帧统计JSON报告
+#include "common/frame_profiler.hpp"  // 逐pass CPU/GPU计时
+#include "common/trace.hpp"           // Chrome trace事件记录
+#include "common/frame_stats.hpp"     // 帧时间直方图与分位数
+#include "common/benchmark.hpp"      // 命令行基准测试
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1900) && !defined(IMGUI_DISABLE_WIN32_FUNCTIONS)
 #pragma comment(lib, "legacy_stdio_definitions")
@@ -48,6 +71,57 @@ static int control_mode = 1;  // 0: ↑↓←→沿坐标轴旋转 鼠标右键
                               // 1：wasd前后左右移动 鼠标旋转视角
 static int flag_display_mode = 0;
 static int flag_control_mode = 0;
+static int flag_render_mode = 0;
+static int flag_frustum_culling = 0;
+static int flag_horizon_culling = 0;
+static int flag_occlusion_culling = 0;
+static int flag_grid_order = 0;
+static int flag_grid_primitive = 0;
+static int flag_lighting = 0;
+static int flag_chunk_submit = 0;
+static int flag_profile_export = 0;
+static int flag_trace = 0;
+enum RENDER_MODE {
+    RENDER_VERTEX_BUFFER,   // 每顶点vec3（烘焙高度）
+    RENDER_PACKED_VERTEX,   // 量化顶点：块内行列各1字节+16位高度，共4字节，按块uniform解码
+    RENDER_HEIGHT_TEXTURE,  // 顶点着色器按gl_VertexID采样高度纹理，无顶点缓冲
+    RENDER_GEOMIP,          // 几何mipmap：按屏幕误差逐块选LOD，接缝处缝合
+    RENDER_CDLOD,           // CDLOD：四叉树按距离选LOD，顶点平滑过渡
+    RENDER_CLIPMAP,         // 几何clipmap：以相机为中心的嵌套环，环形纹理只上传新露出的条带
+    RENDER_STREAMING,       // 分块流式加载：后台线程读.thf分块，LRU缓存在纹理数组中，每帧限量上传
+    RENDER_MODE_COUNT
+};
+static const char* render_mode_names[RENDER_MODE_COUNT] = { "vertex buffer", "packed vertices", "height texture", "geomipmapping", "CDLOD", "clipmap", "streamed tiles" };
+static int render_mode = RENDER_HEIGHT_TEXTURE;
+static const char* terrain_path = "res/terrain.bmp";  // 地形高度图
+static const char* terrain_tiles_path = "res/terrain.thf";  // 流式加载用的分块文件，只由 --convert 生成
+static const float terrain_spacing = 0.1f;       // 顶点XZ间距
+static const float terrain_height_scale = 1.0f;  // 高度缩放
+static const int terrain_chunk_size = 65;  // 分块边长（顶点），分块后可逐块剔除，每块用16位索引；0: 整体一次绘制（按顶点数选16/32位索引）
+static bool frustum_culling = true;  // F4切换视锥剔除
+static bool horizon_culling = true;  // F5切换地平线遮挡剔除（山谷中被山脊挡住的块）
+static bool occlusion_culling = true;  // F6切换软件深度缓冲遮挡剔除
+static GRID_ORDER grid_order = GRID_ORDER::COLUMN_STRIPS;  // F7切换索引顺序：行优先 / 列条带（顶点缓存友好）
+static bool terrain_lighting = true;  // F9切换法线光照（高度纹理/几何mipmap模式）
+static CHUNK_SUBMIT chunk_submit = CHUNK_SUBMIT::MULTI_DRAW;  // F10切换分块提交方式：逐块draw call / multi-draw / indirect
+static const char* chunk_submit_names[] = { "per chunk", "multi-draw", "indirect" };
+enum PROFILE_SCOPE {
+    PROFILE_UPLOAD,   // clipmap条带 / 流式分块上传
+    PROFILE_TERRAIN,  // LOD选择、剔除与地形绘制
+    PROFILE_UI,       // GUI构建与绘制
+    PROFILE_SCOPE_COUNT
+};
+static const char* profile_scope_names[PROFILE_SCOPE_COUNT] = { "upload", "terrain", "ui" };
+static const char* profile_csv_path = "profile.csv";  // F11导出各pass耗时
+static const char* frame_stats_path = "frame_times.json";  // 退出时写出帧时间分位数与直方图
+static const char* trace_path = "trace.json";  // F12开始/停止记录Chrome trace（chrome://tracing 或 ui.perfetto.dev 打开）
+static GRID_PRIMITIVE grid_primitive = GRID_PRIMITIVE::TRIANGLES;  // F8切换图元：三角形列表 / 三角形带+图元重启（索引约减半）
+static bool headless = false;  // --headless：隐藏窗口，渲染到FBO，回放相机路径N帧后写出JSON报告并退出
+static int headless_frames = 0;
+static const char* headless_report = "frame_report.json";
+static const char* camera_record_path = NULL;  // --record：每帧相机状态写入.tcam文件（退出时保存）
+static CameraPath camera_path;  // 回放（--replay / --headless）或录制中的相机路径
+static bool camera_replay = false;  // 相机取自camera_path，按固定步长推进
 
 //static glm::mat4 rotation = glm::mat4(1.0);
 //static glm::mat4 translation = glm::mat4(1.0);
@@ -83,9 +157,13 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 }
 
 GLuint load_BMP_texture(const char* imagepath) {
+    TRACE_SCOPE("load_BMP_texture");
     // 纹理data
     BMP bmp;
-    bmp.Read(imagepath);
+    {
+        TRACE_SCOPE("BMP::Read");
+        bmp.Read(imagepath);
+    }
     int width = bmp.GetWidth();
     int height = bmp.GetHeight();
     byte* data = bmp.GetPixelBuffer();
@@ -108,8 +186,159 @@ GLuint load_BMP_texture(const char* imagepath) {
     return textureID;
 }
 
-int main()
+// 按当前索引顺序生成地形索引（分块或整体）
+static void build_terrain_indices(int width, int height, TerrainMeshBuilder& builder,
+    TerrainIndexBuffer& indices, TerrainPatchSet& patches)
+{
+    if (terrain_chunk_size > 0) {
+        BuildGridPatches(width, height, terrain_chunk_size, patches, grid_order, grid_primitive);
+    }
+    else {
+        builder.SetGridOrder(grid_order);
+        builder.SetGridPrimitive(grid_primitive);
+        builder.BuildIndices(width, height, indices);
+    }
+}
+
+// 上传地形索引到elementbuffer，返回索引字节数
+static size_t upload_terrain_indices(GLuint elementbuffer, const TerrainIndexBuffer& indices, const TerrainPatchSet& patches)
+{
+    TRACE_SCOPE("upload_terrain_indices");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+    if (!patches.patches.empty()) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, patches.indices.size() * sizeof(GLushort), &patches.indices[0], GL_STATIC_DRAW);
+        return patches.indices.size() * sizeof(GLushort);
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.ByteSize(), indices.Data(), GL_STATIC_DRAW);
+    return indices.ByteSize();
+}
+
+// 模拟32项FIFO顶点缓存，统计当前索引的ACMR/ATVR
+static VertexCacheStats analyze_terrain_indices(int width, int height,
+    const TerrainIndexBuffer& indices, const TerrainPatchSet& patches)
+{
+    if (!patches.patches.empty())
+        return AnalyzeVertexCache(patches);
+    return AnalyzeVertexCache(indices, (size_t)width * height);
+}
+
+// 生成烘焙了高度的vec3顶点缓冲（分块绘制时按块重排顶点）
+static GLuint create_vertex_buffer(const Heightfield& terrain, const TerrainMeshBuilder& builder,
+    const TerrainPatchSet& patches, size_t& bytes)
 {
+    TRACE_SCOPE("create_vertex_buffer");
+    std::vector<glm::vec3> vertices;
+    builder.BuildVertices(terrain, vertices);
+    if (!patches.patches.empty()) {
+        std::vector<glm::vec3> patch_vertices;
+        ReorderVerticesToPatches(vertices, terrain.width, patches, patch_vertices);
+        vertices.swap(patch_vertices);
+    }
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+    bytes = vertices.size() * sizeof(glm::vec3);
+    return buffer;
+}
+
+// 生成量化顶点缓冲（分块时块内坐标，否则整体坐标），解码参数写入packed
+static GLuint create_packed_vertex_buffer(const Heightfield& terrain, const TerrainMeshBuilder& builder,
+    const TerrainPatchSet& patches, PackedVertexBuffer& packed, size_t& bytes)
+{
+    TRACE_SCOPE("create_packed_vertex_buffer");
+    builder.BuildPackedVertices(terrain, patches, packed);
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, packed.data.size(), &packed.data[0], GL_STATIC_DRAW);
+    bytes = packed.data.size();
+    // 解码参数已记录，CPU端数据不再需要
+    std::vector<unsigned char>().swap(packed.data);
+    return buffer;
+}
+
+// GUI顶点/索引数据写入每帧环形缓冲（写满时GUI后端退回glBufferData）
+static bool upload_gui_data(const void* data, size_t size, size_t alignment, unsigned int* buffer, size_t* offset, void* user_data)
+{
+    StreamBuffer* ring = (StreamBuffer*)user_data;
+    size_t written = 0;
+    if (!ring->Write(data, size, alignment, written))
+        return false;
+    *buffer = ring->GetBuffer();
+    *offset = written;
+    return true;
+}
+
+// 结束--trace记录并写出trace文件（窗口模式、--bench、--convert退出时都要写）
+static void finish_trace()
+{
+    if (TraceIsEnabled()) {
+        TraceStop();
+        TraceWrite(trace_path);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // 从启动开始记录Chrome trace，退出时写出：3D_Terrain --trace <trace.json> [其余参数]
+    if (argc > 2 && strcmp(argv[1], "--trace") == 0) {
+        trace_path = argv[2];
+        argc -= 2;
+        argv += 2;
+        TraceStart();
+    }
+    TRACE_THREAD_NAME("render");
+    // 命令行基准测试：3D_Terrain --bench <name> [args]
+    if (argc > 2 && strcmp(argv[1], "--bench") == 0) {
+        const int result = RunBenchmark(argv[2], argc - 3, argv + 3);
+        finish_trace();
+        return result;
+    }
+    // 转换为分块高度图：3D_Terrain --convert <输入> <输出.thf> [分块边长] [级数]
+    if (argc > 3 && strcmp(argv[1], "--convert") == 0) {
+        const bool converted = ConvertToTiledHeightfield(argv[2], argv[3], argc > 4 ? atoi(argv[4]) : 256, argc > 5 ? atoi(argv[5]) : 0);
+        finish_trace();
+        return converted ? 0 : 1;
+    }
+    // 录制相机路径：3D_Terrain --record <路径.tcam>
+    if (argc > 2 && strcmp(argv[1], "--record") == 0)
+        camera_record_path = argv[2];
+    // 回放相机路径：3D_Terrain --replay <路径.tcam>，播完退出
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        if (!camera_path.Load(argv[2]))
+            return 1;
+        camera_replay = true;
+    }
+    // 无界面帧时间测试：3D_Terrain --headless <帧数> [报告.json] [渲染模式序号或名称] [路径.tcam]
+    // 给定相机路径时帧数可为0（播完整条路径），否则绕地图中心飞一圈
+    if (argc > 2 && strcmp(argv[1], "--headless") == 0) {
+        headless = true;
+        headless_frames = atoi(argv[2]);
+        if (argc > 3)
+            headless_report = argv[3];
+        if (argc > 4) {
+            render_mode = -1;
+            for (int m = 0; m < RENDER_MODE_COUNT; m++) {
+                if (strcmp(argv[4], render_mode_names[m]) == 0)
+                    render_mode = m;
+            }
+            if (render_mode < 0 && argv[4][0] >= '0' && argv[4][0] <= '9')
+                render_mode = atoi(argv[4]);
+        }
+        if (argc > 5) {
+            if (!camera_path.Load(argv[5]))
+                return 1;
+            if (headless_frames == 0)
+                headless_frames = camera_path.GetFrameCount();
+        }
+        if (headless_frames <= 0 || render_mode < 0 || render_mode >= RENDER_MODE_COUNT) {
+            fprintf(stderr, "Usage: 3D_Terrain --headless <frames> [report.json] [render mode] [camera.tcam]\n");
+            return 1;
+        }
+        camera_replay = true;
+    }
+
     // 初始化GLFW
     if (!glfwInit()){
         fprintf(stderr, "Failed to initialize GLFW\n");
@@ -120,6 +349,7 @@ int main()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // OpenGL 3.3 版本
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
+    glfwWindowHint(GLFW_VISIBLE, headless ? GLFW_FALSE : GLFW_TRUE);  // 无界面模式不显示窗口（无显示器时可用Xvfb或GLFW的EGL/OSMesa平台）
     //glfwWindowHint(GLFW_CONTEXT_PROFILE, GLFW_OPENGL_CORE_PROFILE); //We don't want the old OpenGL
     // 初始化窗口与OpenGL context
     GLFWwindow* window;
@@ -142,7 +372,8 @@ int main()
     // 捕捉键盘事件
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
     // Hide the mouse and enable unlimited mouvement
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!headless)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     // 鼠标滚轮回调
     // Set the mouse at the center of the screen
     glfwPollEvents();
@@ -169,6 +400,10 @@ int main()
     ImGui::StyleColorsDark();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
+    // 每帧上传（GUI、clipmap条带、流式分块）共用的三缓冲环形缓冲：每帧2MB，不够时自动扩大
+    StreamBuffer upload_ring;
+    if (upload_ring.Init(2 << 20, 3))
+        ImGui_ImplOpenGL3_SetUploadFn(upload_gui_data, &upload_ring);
     bool show_demo_window = true;
     bool show_another_window = true;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
@@ -274,28 +509,30 @@ int main()
     */
     // 顶点：BMP地形
     // 加载BMP，读取地形尺寸、地形高度
-    BMP bmp;
-    bmp.Read("res/terrain.bmp");
-    bmp.ConvertTo(BMP::COLOR_MODE::BW, true);
-    const int width = bmp.GetWidth();
-    const int height = bmp.GetHeight();
+    // 高度图：.bmp(8位) / .pgm(8或16位) / .r16 / .r32(浮点)，统一存为16位或浮点高度
+    static Heightfield terrain;
+    if (!LoadHeightfield(terrain_path, terrain)) {
+        fprintf(stderr, "Failed to load terrain %s\n", terrain_path);
+        getchar();
+        glfwTerminate();
+        return -1;
+    }
+    const int width = terrain.width;
+    const int height = terrain.height;
     const float model_w = width * 0.1f;
     const float model_h = height * 0.1f;
     const float model_t = 255 / 255.0f;
     const float model_d = CarmackSqrt((width * width) + (height * height)) * 0.1f;
-    byte* data = bmp.GetPixelBuffer();
-    int size = bmp.GetSize();
-    static std::vector<glm::vec3> g_vertex_buffer_data;
-    for (int row = 0; row < height; row++) {
-        for (int col = 0; col < width; col++)
-        {
-            vec3 tmp;
-            tmp.x = row * 0.1f;
-            tmp.y = data[row * width + col] / 255.0f;
-            tmp.z = col * 0.1f;
-            g_vertex_buffer_data.push_back(tmp);
-        }
-    }
+    // 高度纹理：GL_R16 / GL_R32F
+    GLuint heightTexture = UploadHeightfieldTexture(terrain);
+    // 法线图：中心差分，每采样4字节（GL_RG16_SNORM），多线程+SSE2生成
+    std::vector<short> normal_map;
+    BuildNormalMap(terrain, terrain_spacing, terrain_height_scale, normal_map);
+    GLuint normalTexture = UploadNormalTexture(normal_map, width, height);
+    std::vector<short>().swap(normal_map);
+    // 顶点与索引一次性分配，按行多线程填充
+    TerrainMeshBuilder mesh_builder;  // 默认使用全部CPU核心
+    mesh_builder.SetScale(terrain_spacing, terrain_height_scale);
 
 
     // UV坐标：确定顶点颜色在纹理图片上的位置
@@ -349,23 +586,24 @@ int main()
 
 
     // 索引VBO | 以三角形为单位 | width*height个顶点 | (width-1)*(height-1)个矩形 | 2*(width-1)*(height-1)个三角形 | 3*2*(width-1)*(height-1)个序列号 |
-    int indexSize = (width - 1) * (height - 1) * 2 * 3;
-    static std::vector<GLushort> indices;
-    for (int row = 0; row < height-1; row++)
-    {
-        for (int col = 0; col < width-1; col++)
-        {
-            // 上三角
-            indices.push_back(row * width + col);
-            indices.push_back(row * width + col + 1);
-            indices.push_back((row + 1) * width + col + 1);
-            // 下三角
-            indices.push_back(row * width + col);
-            indices.push_back((row + 1) * width + col + 1);
-            indices.push_back((row + 1) * width + col);
-            
-        }
-    }
+    // 顶点数超过65536时自动改用32位索引；或按≤65536顶点分块，每块用16位索引+baseVertex绘制
+    static TerrainIndexBuffer indices;
+    static TerrainPatchSet patches;
+    static ChunkBounds chunk_bounds;  // 每块AABB（SoA）
+    build_terrain_indices(width, height, mesh_builder, indices, patches);
+    if (terrain_chunk_size > 0)
+        ComputePatchBounds(terrain, patches, terrain_spacing, terrain_height_scale, chunk_bounds);
+    VertexCacheStats index_cache_stats = analyze_terrain_indices(width, height, indices, patches);
+    // 可见块合并提交：高度纹理模式按gl_VertexID / 块步长在分块表中查块的位置
+    ChunkBatcher chunk_batcher;
+    chunk_batcher.Init(patches);
+    // 遮挡体：8x8格的最低高度，近处256格以内使用，更远处用块本身
+    HorizonCuller horizon_culler;
+    horizon_culler.BuildOccluders(terrain, 8, terrain_spacing, terrain_height_scale);
+    horizon_culler.SetOccluderDistance(256 * terrain_spacing);
+    // CPU光栅化：每16个采样一个顶点的低精度遮挡网格，256x128深度缓冲
+    SoftwareOcclusion soft_occlusion(256, 128);
+    soft_occlusion.BuildOccluders(terrain, 16, terrain_spacing, terrain_height_scale);
     
     /*int indexSize = 6;
     std::vector<GLushort> indices;
@@ -378,13 +616,13 @@ int main()
     
     GLuint elementbuffer;
     glGenBuffers(1, &elementbuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
-    // 顶点buffer
-    GLuint vertexbuffer;  // buffer ID
-    glGenBuffers(1, &vertexbuffer);  // 创建
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);  // 绑定
-    glBufferData(GL_ARRAY_BUFFER, g_vertex_buffer_data.size() * sizeof(glm::vec3), &g_vertex_buffer_data[0], GL_STATIC_DRAW);  // 填充 
+    size_t elementbuffer_bytes = upload_terrain_indices(elementbuffer, indices, patches);
+    // 顶点buffer：仅在切换到顶点缓冲模式时才生成（高度纹理模式不需要顶点数据）
+    GLuint vertexbuffer = 0;  // buffer ID
+    size_t vertexbuffer_bytes = 0;
+    GLuint packed_vertexbuffer = 0;  // 量化顶点，仅在量化顶点模式下生成
+    size_t packed_vertexbuffer_bytes = 0;
+    PackedVertexBuffer packed_vertices;
     // GL_STATIC_DRAW ：数据不会或几乎不会改变。
     // GL_DYNAMIC_DRAW：数据会被改变很多。
     // GL_STREAM_DRAW ：数据每次绘制时都会改变。
@@ -404,17 +642,171 @@ int main()
     
     // 变换矩阵
     GLuint MatrixID = glGetUniformLocation(programID, "MVP");
+    GLuint PackedVerticesID = glGetUniformLocation(programID, "packedVertices");
+    GLuint PackedOriginID = glGetUniformLocation(programID, "gridOrigin");
+    GLuint HeightDecodeID = glGetUniformLocation(programID, "heightDecode");
+    glUseProgram(programID);
+    glUniform1f(glGetUniformLocation(programID, "spacing"), terrain_spacing);
+    // 高度纹理位移着色器
+    GLuint heightProgramID = LoadShaders("shader\\heightmap_vertexshader.glsl", "shader\\fragmentshader.glsl");
+    GLuint HeightMatrixID = glGetUniformLocation(heightProgramID, "MVP");
+    GLuint HeightSamplerID = glGetUniformLocation(heightProgramID, "heightTexture");
+    GLuint GridColsID = glGetUniformLocation(heightProgramID, "gridCols");
+    GLuint GridOriginID = glGetUniformLocation(heightProgramID, "gridOrigin");
+    GLuint VertexBaseID = glGetUniformLocation(heightProgramID, "vertexBase");
+    GLuint NormalSamplerID = glGetUniformLocation(heightProgramID, "normalTexture");
+    GLuint LightingID = glGetUniformLocation(heightProgramID, "lighting");
+    GLuint ChunkStrideID = glGetUniformLocation(heightProgramID, "chunkStride");
+    glUseProgram(heightProgramID);
+    glUniform1i(glGetUniformLocation(heightProgramID, "chunkTable"), 2);  // 分块表（buffer纹理）固定在纹理单元2
+    glm::vec3 light_direction = glm::normalize(glm::vec3(0.5f, 0.8f, 0.3f));
+    glUniform3f(glGetUniformLocation(heightProgramID, "lightDirection"), light_direction.x, light_direction.y, light_direction.z);
+    glUniform1f(glGetUniformLocation(heightProgramID, "spacing"), terrain_spacing);
+    glUniform1f(glGetUniformLocation(heightProgramID, "heightScale"), terrain_height_scale);
+    // 几何mipmap：33x33顶点一块，每块6级LOD
+    GeomipTerrain geomip;
+    geomip.Init(terrain, 33, terrain_spacing, terrain_height_scale);
+    // CDLOD：叶节点32x32格，顶点在LOD范围末端向下一级网格过渡
+    GLuint cdlodProgramID = LoadShaders("shader\\cdlod_vertexshader.glsl", "shader\\fragmentshader.glsl");
+    GLuint CdlodMatrixID = glGetUniformLocation(cdlodProgramID, "MVP");
+    GLuint CdlodSamplerID = glGetUniformLocation(cdlodProgramID, "heightTexture");
+    GLuint CdlodCameraID = glGetUniformLocation(cdlodProgramID, "cameraPosition");
+    CdlodTerrain::Uniforms cdlod_uniforms;
+    cdlod_uniforms.nodeOrigin = glGetUniformLocation(cdlodProgramID, "nodeOrigin");
+    cdlod_uniforms.nodeStep = glGetUniformLocation(cdlodProgramID, "nodeStep");
+    cdlod_uniforms.morphRange = glGetUniformLocation(cdlodProgramID, "morphRange");
+    CdlodTerrain cdlod;
+    cdlod.Init(terrain, 32, terrain_spacing, terrain_height_scale);
+    glUseProgram(cdlodProgramID);
+    glUniform1i(glGetUniformLocation(cdlodProgramID, "gridSize"), cdlod.GetLeafSize());
+    glUniform1f(glGetUniformLocation(cdlodProgramID, "spacing"), terrain_spacing);
+    glUniform1f(glGetUniformLocation(cdlodProgramID, "heightScale"), terrain_height_scale);
+    // 几何clipmap：每级256x256环形纹理，级数覆盖整个地形
+    int clipmap_levels = 1;
+    while ((254 << (clipmap_levels - 1)) < (width > height ? width : height) && clipmap_levels < 10)
+        clipmap_levels++;
+    ClipmapTerrain clipmap;
+    clipmap.Init(terrain, clipmap_levels, 256, terrain_spacing);
+    clipmap.SetUploadBuffer(&upload_ring);
+    GLuint clipmapProgramID = LoadShaders("shader\\clipmap_vertexshader.glsl", "shader\\fragmentshader.glsl");
+    GLuint ClipmapMatrixID = glGetUniformLocation(clipmapProgramID, "MVP");
+    GLuint ClipmapSamplerID = glGetUniformLocation(clipmapProgramID, "heightTexture");
+    ClipmapTerrain::Uniforms clipmap_uniforms;
+    clipmap_uniforms.level = glGetUniformLocation(clipmapProgramID, "level");
+    clipmap_uniforms.levelOrigin = glGetUniformLocation(clipmapProgramID, "levelOrigin");
+    glUseProgram(clipmapProgramID);
+    glUniform1i(glGetUniformLocation(clipmapProgramID, "gridVerts"), clipmap.GetGridVertices());
+    glUniform1i(glGetUniformLocation(clipmapProgramID, "levelSize"), clipmap.GetLevelSize());
+    glUniform1i(glGetUniformLocation(clipmapProgramID, "levelCount"), clipmap.GetLevelCount());
+    glUniform1f(glGetUniformLocation(clipmapProgramID, "spacing"), terrain_spacing);
+    glUniform1f(glGetUniformLocation(clipmapProgramID, "heightScale"), terrain_height_scale);
+    // 分块流式加载：2个读取线程，8MB分块缓存，每帧最多上传256KB
+    // 启动时不写资源目录：分块文件缺失、比高度图旧或尺寸/格式不符时关闭该模式，提示用 --convert 重新生成
+    TileStreamer streamer;
+    bool streaming_ready = false;
+    struct stat terrain_stat, tiles_stat;
+    if (stat(terrain_tiles_path, &tiles_stat) != 0) {
+        printf("%s not found, streaming mode disabled\n", terrain_tiles_path);
+    }
+    else if (stat(terrain_path, &terrain_stat) == 0 && terrain_stat.st_mtime > tiles_stat.st_mtime) {
+        printf("%s is older than %s, streaming mode disabled\n", terrain_tiles_path, terrain_path);
+    }
+    else if (streamer.Init(terrain_tiles_path, terrain_spacing, terrain_height_scale, 2, 8 << 20, 256 << 10)) {
+        streaming_ready = streamer.GetWidth() == width && streamer.GetHeight() == height && streamer.GetFormat() == terrain.format;
+        if (!streaming_ready) {
+            printf("%s (%dx%d) does not match %s (%dx%d), streaming mode disabled\n", terrain_tiles_path,
+                streamer.GetWidth(), streamer.GetHeight(), terrain_path, width, height);
+            streamer.Shutdown();
+        }
+    }
+    if (!streaming_ready)
+        printf("To enable it: 3D_Terrain --convert %s %s\n", terrain_path, terrain_tiles_path);
+    if (headless && render_mode == RENDER_STREAMING && !streaming_ready) {
+        fprintf(stderr, "Headless: streaming mode needs %s\n", terrain_tiles_path);
+        glfwTerminate();
+        return 1;
+    }
+    streamer.SetLodRange(2.0f);
+    streamer.SetUploadBuffer(&upload_ring);
+    GLuint streamProgramID = LoadShaders("shader\\stream_vertexshader.glsl", "shader\\fragmentshader.glsl");
+    GLuint StreamMatrixID = glGetUniformLocation(streamProgramID, "MVP");
+    GLuint StreamSamplerID = glGetUniformLocation(streamProgramID, "tileTexture");
+    TileStreamer::Uniforms stream_uniforms;
+    stream_uniforms.slot = glGetUniformLocation(streamProgramID, "slot");
+    stream_uniforms.tileOrigin = glGetUniformLocation(streamProgramID, "tileOrigin");
+    stream_uniforms.tileStep = glGetUniformLocation(streamProgramID, "tileStep");
+    glUseProgram(streamProgramID);
+    glUniform1i(glGetUniformLocation(streamProgramID, "tileVerts"), streamer.GetTileSize() + 1);
+    glUniform2i(glGetUniformLocation(streamProgramID, "mapSize"), streamer.GetWidth(), streamer.GetHeight());
+    glUniform1f(glGetUniformLocation(streamProgramID, "spacing"), terrain_spacing);
+    glUniform1f(glGetUniformLocation(streamProgramID, "heightScale"), terrain_height_scale);
     position = vec3(model_h * 0.5f, 40.0f, model_w * 0.5f);
     vec3 Model_center = glm::vec3(model_h * 0.5f, model_t * 0.5f, model_w * 0.5f);
 
-    double lastTime = glfwGetTime(), FPSTime = glfwGetTime();
-    int FPS = 0, gui_FPS = 0;
+    // 每帧顶点着色器调用次数（GL_ARB_pipeline_statistics_query），读上一帧的结果以免等待GPU
+#ifdef GL_VERTEX_SHADER_INVOCATIONS_ARB
+    const bool vs_query_supported = glewIsSupported("GL_ARB_pipeline_statistics_query") != 0;
+#else
+    const bool vs_query_supported = false;
+#endif
+    GLuint vs_queries[2] = { 0, 0 };
+    if (vs_query_supported)
+        glGenQueries(2, vs_queries);
+    GLuint64 vs_invocations = 0;
+    unsigned int vs_query_frame = 0;
+
+    // 无界面模式：画到FBO（隐藏窗口的默认帧缓冲不保证有像素），不等垂直同步，
+    // 每帧记录CPU时间、GPU时间（GL_TIME_ELAPSED，隔两帧读取以免等待GPU）、三角形与draw call数
+    GLuint headless_fbo = 0;
+    GLuint headless_renderbuffers[2] = { 0, 0 };
+    GLuint time_queries[3] = { 0, 0, 0 };
+    std::vector<FrameSample> headless_samples;
+    int replay_frame = 0;
+    bool report_written = true;
+    if (headless) {
+        glGenRenderbuffers(2, headless_renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, headless_renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_width, window_height);
+        glBindRenderbuffer(GL_RENDERBUFFER, headless_renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &headless_fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, headless_fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless_renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless_renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            fprintf(stderr, "Headless framebuffer incomplete\n");
+        glViewport(0, 0, window_width, window_height);
+        glfwSwapInterval(0);
+        glGenQueries(3, time_queries);
+        // 没有录制的路径时绕地图中心低空飞一圈，视线沿飞行方向向下15°
+        if (camera_path.Empty()) {
+            camera_path = CameraPath::Flyover(Model_center, (model_w < model_h ? model_w : model_h) * 0.3f, 4.0f,
+                glm::radians(15.0f), FoV, headless_frames);
+        }
+        headless_samples.reserve(headless_frames);
+    }
+
+    // 各pass的CPU/GPU耗时（GL_TIMESTAMP查询，晚4帧读取，不等待GPU）
+    FrameProfiler profiler;
+    profiler.Init(profile_scope_names, PROFILE_SCOPE_COUNT);
+
+    double lastTime = glfwGetTime(), statsTime = glfwGetTime();
+    const double record_start = lastTime;
+    // 帧时间直方图：整个运行期间（退出时写出）和最近一秒（每秒汇总一次给GUI），每帧只是计数，不分配内存
+    FrameStats frame_stats, frame_stats_second;
+    FrameStats::Summary run_summary = frame_stats.GetSummary();
+    FrameStats::Summary second_summary = run_summary;
     
     // 主循环
     do {
-        
+        TRACE_SCOPE("frame");
+        double frame_start = glfwGetTime();
+        upload_ring.BeginFrame();  // 等待（或孤立）三帧前用过的区段
+        profiler.BeginFrame();
+        if (headless)
+            glBeginQuery(GL_TIME_ELAPSED, time_queries[replay_frame % 3]);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // 清屏+清除深度缓冲区
-        glUseProgram(programID);  // 运行着色器
         //glActiveTexture(GL_TEXTURE0);  // 启用纹理单元
         //glBindTexture(GL_TEXTURE_2D, Texture);  // 绑定纹理
         //glUniform1i(TextureID, 0);  // 设置采样器使用纹理单元
@@ -423,25 +815,41 @@ int main()
         // 显示帧数
         double currentTime = glfwGetTime();
         float deltaTime = float(currentTime - lastTime);
-        FPS++;
-        if (currentTime - FPSTime >= 1.0)
+        frame_stats.Record(deltaTime * 1000.0f);
+        frame_stats_second.Record(deltaTime * 1000.0f);
+        if (camera_replay)
+            deltaTime = camera_path.GetTimestep();  // 回放时按固定步长推进，与实际帧时间无关
+        if (currentTime - statsTime >= 1.0)
         {
-            printf("FPS: %d\n", FPS);
-            gui_FPS = FPS;
-            FPS = 0;
-            FPSTime += 1.0;
+            second_summary = frame_stats_second.GetSummary();
+            run_summary = frame_stats.GetSummary();
+            printf("Frame ms: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f  stutters %zu\n", second_summary.p50Ms,
+                second_summary.p95Ms, second_summary.p99Ms, second_summary.maxMs, second_summary.stutters);
+            frame_stats_second.Reset();
+            statsTime += 1.0;
         }
 
         // 生成变换矩阵
-        double xpos, ypos;
-        glfwGetCursorPos(window, &xpos, &ypos);
-        glfwSetCursorPos(window, window_width * 0.5, window_height * 0.5);  // 重置光标至窗口中央
-        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {  // 拉近视野
-            scroll_callback(window, 0.0f, (ypos - 384) * 0.05f);
+        if (camera_replay) {
+            // 相机位姿取自路径（第replay_frame个固定步长处），不读鼠标
+            const CameraKey key = camera_path.SampleFrame(replay_frame);
+            position = key.position;
+            horizontalAngle = key.horizontalAngle;
+            verticalAngle = key.verticalAngle;
+            FoV = key.fov;
+            Model = key.model;
         }
         else {
-            horizontalAngle += speed_mouse * float(window_width *0.5 - xpos);
-            verticalAngle += speed_mouse * float(window_height *0.5 - ypos);
+            double xpos, ypos;
+            glfwGetCursorPos(window, &xpos, &ypos);
+            glfwSetCursorPos(window, window_width * 0.5, window_height * 0.5);  // 重置光标至窗口中央
+            if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {  // 拉近视野
+                scroll_callback(window, 0.0f, (ypos - 384) * 0.05f);
+            }
+            else {
+                horizontalAngle += speed_mouse * float(window_width *0.5 - xpos);
+                verticalAngle += speed_mouse * float(window_height *0.5 - ypos);
+            }
         }
         
 
@@ -457,7 +865,11 @@ int main()
         );  // 右向（水平方向）
         glm::vec3 up = glm::cross(right, direction);  // 叉乘获得上方向：与前两者垂直
 
-        if (control_mode)
+        if (camera_replay)
+        {
+            // 回放时相机与模型只由路径决定，方向键/WASD不起作用
+        }
+        else if (control_mode)
         {
             float rotation_radius = 0.0f;
             // Closer
@@ -517,6 +929,87 @@ int main()
             flag_control_mode = 0;
             control_mode = control_mode == 1 ? 0 : 1;
         }
+        // 视锥剔除开关
+        if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS) {
+            flag_frustum_culling = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_RELEASE && flag_frustum_culling) {
+            flag_frustum_culling = 0;
+            frustum_culling = !frustum_culling;
+        }
+        if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS) {
+            flag_horizon_culling = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_RELEASE && flag_horizon_culling) {
+            flag_horizon_culling = 0;
+            horizon_culling = !horizon_culling;
+        }
+        if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS) {
+            flag_occlusion_culling = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_RELEASE && flag_occlusion_culling) {
+            flag_occlusion_culling = 0;
+            occlusion_culling = !occlusion_culling;
+        }
+        if (glfwGetKey(window, GLFW_KEY_F7) == GLFW_PRESS) {
+            flag_grid_order = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F7) == GLFW_RELEASE && flag_grid_order) {
+            flag_grid_order = 0;
+            grid_order = grid_order == GRID_ORDER::ROWS ? GRID_ORDER::COLUMN_STRIPS : GRID_ORDER::ROWS;
+            build_terrain_indices(width, height, mesh_builder, indices, patches);
+            index_cache_stats = analyze_terrain_indices(width, height, indices, patches);
+            elementbuffer_bytes = upload_terrain_indices(elementbuffer, indices, patches);
+            chunk_batcher.Init(patches);
+        }
+        if (glfwGetKey(window, GLFW_KEY_F8) == GLFW_PRESS) {
+            flag_grid_primitive = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F8) == GLFW_RELEASE && flag_grid_primitive) {
+            flag_grid_primitive = 0;
+            grid_primitive = grid_primitive == GRID_PRIMITIVE::TRIANGLES ? GRID_PRIMITIVE::STRIPS : GRID_PRIMITIVE::TRIANGLES;
+            build_terrain_indices(width, height, mesh_builder, indices, patches);
+            index_cache_stats = analyze_terrain_indices(width, height, indices, patches);
+            elementbuffer_bytes = upload_terrain_indices(elementbuffer, indices, patches);
+            chunk_batcher.Init(patches);
+            // 三角形带的分块最大255顶点，分块布局可能改变：顶点缓冲按需重建
+            if (vertexbuffer) {
+                glDeleteBuffers(1, &vertexbuffer);
+                vertexbuffer = 0;
+            }
+            if (packed_vertexbuffer) {
+                glDeleteBuffers(1, &packed_vertexbuffer);
+                packed_vertexbuffer = 0;
+            }
+        }
+        if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS) {
+            flag_lighting = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_RELEASE && flag_lighting) {
+            flag_lighting = 0;
+            terrain_lighting = !terrain_lighting;
+        }
+        if (glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS) {
+            flag_chunk_submit = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F10) == GLFW_RELEASE && flag_chunk_submit) {
+            flag_chunk_submit = 0;
+            chunk_submit = (CHUNK_SUBMIT)(((int)chunk_submit + 1) % 3);
+            if (chunk_submit == CHUNK_SUBMIT::INDIRECT && !ChunkBatcher::IndirectSupported())
+                chunk_submit = CHUNK_SUBMIT::PER_CHUNK;
+        }
+        if (glfwGetKey(window, GLFW_KEY_F11) == GLFW_PRESS) {
+            flag_profile_export = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F11) == GLFW_RELEASE && flag_profile_export) {
+            flag_profile_export = 0;
+            if (profiler.WriteCsv(profile_csv_path))
+                printf("Wrote %d frames to %s\n", profiler.GetHistorySize(), profile_csv_path);
+        }
+        if (glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS) {
+            flag_trace = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F12) == GLFW_RELEASE && flag_trace) {
+            flag_trace = 0;
+            if (TraceIsEnabled()) {
+                TraceStop();
+                TraceWrite(trace_path);
+            }
+            else {
+                TraceStart();
+            }
+        }
         // 点线面绘制切换
         if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS) {
             flag_display_mode = 1;
@@ -538,7 +1031,26 @@ int main()
             }
             glPolygonMode(GL_FRONT_AND_BACK, display_mode); // 设置绘制方式: GL_LINE线框 GL_POINT点 GL_FILL填充
         }
+        // 渲染模式切换
+        if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS) {
+            flag_render_mode = 1;
+        } else if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_RELEASE && flag_render_mode) {
+            flag_render_mode = 0;
+            render_mode = (render_mode + 1) % RENDER_MODE_COUNT;
+            if (render_mode == RENDER_STREAMING && !streaming_ready)
+                render_mode = (render_mode + 1) % RENDER_MODE_COUNT;
+        }
         //Model = translation * rotation * scaling * Model;  // Model矩阵生成遵循 缩放=>旋转=>位移 的顺序，防止相互影响
+        if (camera_record_path) {
+            CameraKey key;
+            key.time = (float)(currentTime - record_start);
+            key.position = position;
+            key.horizontalAngle = horizontalAngle;
+            key.verticalAngle = verticalAngle;
+            key.fov = FoV;
+            key.model = Model;
+            camera_path.Add(key);
+        }
         Projection = glm::perspective(glm::radians(FoV), window_ratio, 0.1f, 100.0f);  // 透视矩阵：45°视场， 4/3比例， 0.1~100显示范围
         //Projection = glm::ortho(-FoV, FoV, -FoV, FoV, 0.0f, 100.0f);  // 正交透视矩阵, 远近比例不变
         View = glm::lookAt(
@@ -548,22 +1060,58 @@ int main()
         );  // lookat矩阵
         MVP = Projection * View * Model;  // 合成 Model | View | Projection
         lastTime = currentTime;
-        // 传递变换矩阵
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);  // 位置；矩阵个数；是否置换；矩阵数据
-
 
+        if (render_mode == RENDER_PACKED_VERTEX) {
+            if (packed_vertexbuffer == 0)
+                packed_vertexbuffer = create_packed_vertex_buffer(terrain, mesh_builder, patches, packed_vertices, packed_vertexbuffer_bytes);
+            glUseProgram(programID);
+            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
+            glUniform1i(PackedVerticesID, 1);
+            glUniform2i(PackedOriginID, 0, 0);
+            glUniform2f(HeightDecodeID, packed_vertices.heightBase, packed_vertices.heightStep);
+            // 整数属性：4个分量（字节或短整型）原样送入uvec4
+            glDisableVertexAttribArray(0);
+            glEnableVertexAttribArray(3);
+            glBindBuffer(GL_ARRAY_BUFFER, packed_vertexbuffer);
+            glVertexAttribIPointer(3, 4, packed_vertices.componentType, 0, (void*)0);
+        }
+        else if (render_mode != RENDER_VERTEX_BUFFER) {
+            // 无顶点属性：XZ由gl_VertexID推出，Y从高度纹理采样
+            glUseProgram(heightProgramID);
+            glUniformMatrix4fv(HeightMatrixID, 1, GL_FALSE, &MVP[0][0]);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, heightTexture);
+            glUniform1i(HeightSamplerID, 0);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, normalTexture);
+            glUniform1i(NormalSamplerID, 1);
+            glActiveTexture(GL_TEXTURE0);
+            glUniform1i(LightingID, terrain_lighting ? 1 : 0);
+            glUniform1i(GridColsID, width);
+            glUniform2i(GridOriginID, 0, 0);
+            glUniform1i(VertexBaseID, 0);
+        }
+        else {
+            if (vertexbuffer == 0)
+                vertexbuffer = create_vertex_buffer(terrain, mesh_builder, patches, vertexbuffer_bytes);
+            glUseProgram(programID);  // 运行着色器
+            // 传递变换矩阵
+            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);  // 位置；矩阵个数；是否置换；矩阵数据
+            glUniform1i(PackedVerticesID, 0);
+            glDisableVertexAttribArray(3);
 
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);  // layout(location)
-        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-        glVertexAttribPointer(
-            0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
+            // 1rst attribute buffer : vertices
+            glEnableVertexAttribArray(0);  // layout(location)
+            glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+            glVertexAttribPointer(
+                0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
+                3,                  // size
+                GL_FLOAT,           // type
+                GL_FALSE,           // normalized?
+                0,                  // stride
+                (void*)0            // array buffer offset
+            );
+        }
 
         // 2nd attribute buffer : colors
         /*//for (int v = 0; v < 12 * 3; v++) {
@@ -601,27 +1149,246 @@ int main()
         //glDrawArrays(GL_TRIANGLES, 0, 3*12); // 绘制三角形! Starting from vertex 0; 3 vertices total -> 1 triangle
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
         glEnableClientState(GL_VERTEX_ARRAY);
-        glDrawElements(
-            GL_TRIANGLES,
-            indices.size(),
-            GL_UNSIGNED_SHORT,
-            (void*)0
-        );
+        size_t triangles_drawn = 0;
+        size_t draw_calls = 0;  // 地形的draw call数（不含GUI）
+        size_t chunks_drawn = 0;
+        float cull_ms = 0.0f;
+        float submit_ms = 0.0f;
+        // 各级clipmap以相机为中心，只上传新露出的L形条带；流式加载上传后台线程读完的分块
+        profiler.Begin(PROFILE_UPLOAD);
+        if (render_mode == RENDER_CLIPMAP)
+            clipmap.Update(glm::vec3(glm::inverse(Model) * glm::vec4(position, 1.0f)));
+        else if (render_mode == RENDER_STREAMING && streaming_ready)
+            streamer.Update(glm::vec3(glm::inverse(Model) * glm::vec4(position, 1.0f)));
+        profiler.End(PROFILE_UPLOAD);
+        profiler.Begin(PROFILE_TERRAIN);
+#ifdef GL_VERTEX_SHADER_INVOCATIONS_ARB
+        if (vs_query_supported)
+            glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB, vs_queries[vs_query_frame & 1]);
+#endif
+        if (render_mode == RENDER_GEOMIP) {
+            // 相机变换到模型空间后按屏幕误差选LOD
+            glm::vec3 camera_model = glm::vec3(glm::inverse(Model) * glm::vec4(position, 1.0f));
+            geomip.Select(camera_model, (float)window_height, glm::radians(FoV));
+            glUniform1i(GridColsID, geomip.GetPatchSize());
+            geomip.Draw(GridOriginID);
+            triangles_drawn = geomip.GetTriangleCount();
+            draw_calls = geomip.GetPatchCount();
+        }
+        else if (render_mode == RENDER_CDLOD) {
+            glm::vec3 camera_model = glm::vec3(glm::inverse(Model) * glm::vec4(position, 1.0f));
+            cdlod.Select(camera_model);
+            glUseProgram(cdlodProgramID);
+            glUniformMatrix4fv(CdlodMatrixID, 1, GL_FALSE, &MVP[0][0]);
+            glUniform1i(CdlodSamplerID, 0);
+            glUniform3f(CdlodCameraID, camera_model.x, camera_model.y, camera_model.z);
+            cdlod.Draw(cdlod_uniforms);
+            triangles_drawn = cdlod.GetTriangleCount();
+            draw_calls = cdlod.GetSelectedCount();
+        }
+        else if (render_mode == RENDER_CLIPMAP) {
+            glUseProgram(clipmapProgramID);
+            glUniformMatrix4fv(ClipmapMatrixID, 1, GL_FALSE, &MVP[0][0]);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, clipmap.GetTexture());
+            glUniform1i(ClipmapSamplerID, 0);
+            clipmap.Draw(clipmap_uniforms);
+            triangles_drawn = clipmap.GetTriangleCount();
+            draw_calls = clipmap.GetLevelCount();
+        }
+        else if (render_mode == RENDER_STREAMING) {
+            // 缺失的分块交给后台线程，本帧先画已驻留的粗一级分块
+            if (streaming_ready) {
+                glUseProgram(streamProgramID);
+                glUniformMatrix4fv(StreamMatrixID, 1, GL_FALSE, &MVP[0][0]);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, streamer.GetTexture());
+                glUniform1i(StreamSamplerID, 0);
+                streamer.Draw(stream_uniforms);
+                triangles_drawn = streamer.GetTriangleCount();
+                draw_calls = streamer.GetDrawnTiles();
+            }
+        }
+        else if (!patches.patches.empty()) {
+            // 模型空间视锥平面，只绘制与视锥相交的块
+            static std::vector<unsigned int> visible_chunks;
+            double cull_start = glfwGetTime();
+            if (frustum_culling && chunk_bounds.Count() == patches.patches.size()) {
+                glm::vec4 frustum[6];
+                ExtractFrustumPlanes(MVP, frustum);
+                CullChunks(frustum, chunk_bounds, visible_chunks);
+            }
+            else {
+                visible_chunks.resize(patches.patches.size());
+                for (size_t p = 0; p < visible_chunks.size(); p++)
+                    visible_chunks[p] = (unsigned int)p;
+            }
+            if (horizon_culling && chunk_bounds.Count() == patches.patches.size()) {
+                static std::vector<unsigned int> unoccluded_chunks;
+                glm::vec3 camera_model = glm::vec3(glm::inverse(Model) * glm::vec4(position, 1.0f));
+                horizon_culler.Cull(camera_model, chunk_bounds, visible_chunks, unoccluded_chunks);
+                visible_chunks.swap(unoccluded_chunks);
+            }
+            if (occlusion_culling && chunk_bounds.Count() == patches.patches.size()) {
+                static std::vector<unsigned int> unoccluded_chunks;
+                soft_occlusion.Render(MVP);
+                soft_occlusion.Cull(chunk_bounds, visible_chunks, unoccluded_chunks);
+                visible_chunks.swap(unoccluded_chunks);
+            }
+            cull_ms = (float)((glfwGetTime() - cull_start) * 1000.0);
+            chunks_drawn = visible_chunks.size();
+            // 三角形带之间以0xFFFF分隔（与baseVertex相加之前比较）
+            if (patches.mode == GL_TRIANGLE_STRIP) {
+                glEnable(GL_PRIMITIVE_RESTART);
+                glPrimitiveRestartIndex(GRID_RESTART_INDEX16);
+            }
+            // 量化顶点的块原点只能逐块设置，始终逐块提交
+            const CHUNK_SUBMIT submit = render_mode == RENDER_PACKED_VERTEX ? CHUNK_SUBMIT::PER_CHUNK : chunk_submit;
+            double submit_start = glfwGetTime();
+            if (submit != CHUNK_SUBMIT::PER_CHUNK) {
+                // 无顶点缓冲时baseVertex = 块号 * 块步长，着色器由gl_VertexID反推块号
+                const bool virtual_vertices = render_mode == RENDER_HEIGHT_TEXTURE;
+                chunk_batcher.Build(patches, visible_chunks, virtual_vertices);
+                if (virtual_vertices) {
+                    glActiveTexture(GL_TEXTURE2);
+                    glBindTexture(GL_TEXTURE_BUFFER, chunk_batcher.GetChunkTexture());
+                    glActiveTexture(GL_TEXTURE0);
+                    glUniform1i(ChunkStrideID, chunk_batcher.GetChunkStride());
+                }
+                chunk_batcher.Submit(submit, patches.mode, &upload_ring);
+                draw_calls = visible_chunks.empty() ? 0 : 1;
+                if (virtual_vertices)
+                    glUniform1i(ChunkStrideID, 0);
+                for (size_t v = 0; v < visible_chunks.size(); v++) {
+                    const TerrainPatch& patch = patches.patches[visible_chunks[v]];
+                    triangles_drawn += (size_t)(patch.rows - 1) * (patch.cols - 1) * 2;
+                }
+            }
+            else {
+                for (size_t v = 0; v < visible_chunks.size(); v++) {
+                    const TerrainPatch& patch = patches.patches[visible_chunks[v]];
+                    if (render_mode == RENDER_HEIGHT_TEXTURE) {
+                        glUniform1i(GridColsID, patch.cols);
+                        glUniform2i(GridOriginID, patch.col, patch.row);
+                        glUniform1i(VertexBaseID, patch.baseVertex);
+                    }
+                    else if (render_mode == RENDER_PACKED_VERTEX) {
+                        glUniform2i(PackedOriginID, patch.col, patch.row);
+                    }
+                    glDrawElementsBaseVertex(patches.mode, patch.indexCount, GL_UNSIGNED_SHORT,
+                        (void*)(patch.firstIndex * sizeof(GLushort)), patch.baseVertex);
+                    triangles_drawn += (size_t)(patch.rows - 1) * (patch.cols - 1) * 2;
+                }
+                draw_calls = visible_chunks.size();
+            }
+            submit_ms = (float)((glfwGetTime() - submit_start) * 1000.0);
+            glDisable(GL_PRIMITIVE_RESTART);
+        }
+        else {
+            if (indices.mode == GL_TRIANGLE_STRIP) {
+                glEnable(GL_PRIMITIVE_RESTART);
+                glPrimitiveRestartIndex(indices.RestartIndex());
+            }
+            glDrawElements(
+                indices.mode,   // GL_TRIANGLES / GL_TRIANGLE_STRIP
+                (GLsizei)indices.Count(),
+                indices.type,   // GL_UNSIGNED_SHORT / GL_UNSIGNED_INT
+                (void*)0
+            );
+            glDisable(GL_PRIMITIVE_RESTART);
+            triangles_drawn = (size_t)(width - 1) * (height - 1) * 2;
+            draw_calls = 1;
+        }
+        profiler.End(PROFILE_TERRAIN);
+#ifdef GL_VERTEX_SHADER_INVOCATIONS_ARB
+        if (vs_query_supported) {
+            glEndQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+            if (vs_query_frame > 0)
+                glGetQueryObjectui64v(vs_queries[(vs_query_frame + 1) & 1], GL_QUERY_RESULT, &vs_invocations);
+            vs_query_frame++;
+        }
+#endif
 
 
+        profiler.Begin(PROFILE_UI);
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
         //ImGui::ShowDemoWindow(&show_demo_window);
         ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
-        ImGui::SetNextWindowSize(ImVec2(220.0f, 270.0f));
+        ImGui::SetNextWindowSize(ImVec2(240.0f, 720.0f));
         ImGui::Begin("GUI");  // GUI标题
         ImGui::SameLine();
-        ImGui::Text("FPS: %d", gui_FPS);
+        ImGui::Text("FPS: %zu", second_summary.frames);
+        // 上一秒的分位数，卡顿 = 超过中位数2倍的帧；Run为整个运行期间
+        ImGui::Text("Frame p50 %.2f  p95 %.2f ms", second_summary.p50Ms, second_summary.p95Ms);
+        ImGui::Text("      p99 %.2f  max %.2f ms", second_summary.p99Ms, second_summary.maxMs);
+        ImGui::Text("Stutters: %zu  >33 ms: %zu", second_summary.stutters, second_summary.slowFrames);
+        ImGui::Text("Run p99 %.2f  max %.2f ms", run_summary.p99Ms, run_summary.maxMs);
+        ImGui::Text("Run stutters: %zu / %zu", run_summary.stutters, run_summary.frames);
+        ImGui::Text("Mode: %s", render_mode_names[render_mode]);
+        if (camera_record_path)
+            ImGui::Text("Recording: %zu frames", camera_path.Size());
+        if (camera_replay)
+            ImGui::Text("Replay: frame %d / %d", replay_frame, camera_path.GetFrameCount());
+        size_t vertex_memory = render_mode == RENDER_VERTEX_BUFFER ? vertexbuffer_bytes :
+            render_mode == RENDER_PACKED_VERTEX ? packed_vertexbuffer_bytes : 0;
+        ImGui::Text("Vertex memory: %.1f MB", vertex_memory / (1024.0f * 1024.0f));
+        ImGui::Text("Triangles: %zu", triangles_drawn);
+        if (render_mode == RENDER_CDLOD)
+            ImGui::Text("Nodes: %zu (%zu visited)", cdlod.GetSelectedCount(), cdlod.GetNodesVisited());
+        if (render_mode == RENDER_CLIPMAP)
+            ImGui::Text("Upload: %.1f KB/frame", clipmap.GetBytesUploaded() / 1024.0f);
+        if (render_mode == RENDER_STREAMING) {
+            const TileStreamer::Stats& stream_stats = streamer.GetStats();
+            ImGui::Text("Tiles: %zu drawn, %zu / %zu slots", streamer.GetDrawnTiles(), stream_stats.resident, stream_stats.slots);
+            ImGui::Text("Cache hits: %.1f%%  in flight: %.0f KB", stream_stats.HitRate() * 100.0f, stream_stats.bytesInFlight / 1024.0f);
+            ImGui::Text("Upload: %.1f KB (%.3f ms)", stream_stats.bytesUploaded / 1024.0f, stream_stats.uploadMs);
+        }
+        const StreamBuffer::Stats& ring_stats = upload_ring.GetStats();
+        ImGui::Text("Ring: %.1f / %zu KB (%s)", ring_stats.bytesWritten / 1024.0f, upload_ring.GetFrameBytes() / 1024,
+            upload_ring.IsPersistent() ? "persistent" : "orphaning");
+        ImGui::Text("Ring stalls: %zu waits, %zu orphans", ring_stats.waits, ring_stats.orphans);
+        // 各pass耗时曲线（无GPU计时器时为CPU时间），标注历史均值
+        ImGui::Text("Passes, cpu / gpu ms%s:", profiler.HasGpuTimer() ? "" : " (no GPU timer)");
+        for (int p = 0; p < PROFILE_SCOPE_COUNT; p++) {
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%s %.2f / %.2f", profile_scope_names[p], profiler.GetCpuAverage(p), profiler.GetGpuAverage(p));
+            ImGui::PushID(p);
+            ImGui::PlotLines("", profiler.HasGpuTimer() ? profiler.GetGpuHistory(p) : profiler.GetCpuHistory(p),
+                profiler.GetHistorySize(), profiler.GetHistoryOffset(), overlay, 0.0f, FLT_MAX, ImVec2(220.0f, 36.0f));
+            ImGui::PopID();
+        }
+        if (profiler.GetDroppedFrames() > 0)
+            ImGui::Text("Profiler: %zu frames dropped", profiler.GetDroppedFrames());
+        ImGui::Text("Index order: %s", grid_order == GRID_ORDER::ROWS ? "rows" : "column strips");
+        ImGui::Text("Primitive: %s (%.1f KB)", grid_primitive == GRID_PRIMITIVE::STRIPS ? "strips" : "triangles",
+            elementbuffer_bytes / 1024.0f);
+        ImGui::Text("ACMR %.2f  ATVR %.2f (FIFO 32)", index_cache_stats.acmr, index_cache_stats.atvr);
+        if (vs_query_supported)
+            ImGui::Text("VS invocations: %llu", (unsigned long long)vs_invocations);
+        if (chunks_drawn > 0)
+            ImGui::Text("Chunks: %zu / %zu (cull %.3f ms)", chunks_drawn, patches.patches.size(), cull_ms);
+        if (chunks_drawn > 0)
+            ImGui::Text("Submit: %s %.3f ms", chunk_submit_names[render_mode == RENDER_PACKED_VERTEX ? 0 : (int)chunk_submit], submit_ms);
+        if (chunks_drawn > 0 && horizon_culling)
+            ImGui::Text("Horizon: %.1f%% rejected", horizon_culler.GetRejectedPercent());
+        if (chunks_drawn > 0 && occlusion_culling)
+            ImGui::Text("Depth buffer: %.1f%% rejected", soft_occlusion.GetRejectedPercent());
         ImGui::Separator();
         ImGui::Text("Help: ");
         ImGui::BulletText("F1: switch display mode");
         ImGui::BulletText("F2: switch control mode");
+        ImGui::BulletText("F3: switch render mode");
+        ImGui::BulletText("F4: frustum culling on/off");
+        ImGui::BulletText("F5: horizon culling on/off");
+        ImGui::BulletText("F6: occlusion culling on/off");
+        ImGui::BulletText("F7: switch index order");
+        ImGui::BulletText("F8: triangles / strips");
+        ImGui::BulletText("F9: lighting on/off");
+        ImGui::BulletText("F10: chunk submission");
+        ImGui::BulletText("F11: export pass times (CSV)");
+        ImGui::BulletText(TraceIsEnabled() ? "F12: stop tracing (recording)" : "F12: start tracing");
         ImGui::BulletText("Mouse right press: scaling");
         ImGui::BulletText("Mouse scrolling: scaling");
         ImGui::BulletText("ESC: quit");
@@ -649,27 +1416,99 @@ int main()
 
 
         glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(3);
         //glDisableVertexAttribArray(1);
         glDisableClientState(GL_VERTEX_ARRAY);
 
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        profiler.End(PROFILE_UI);
+        upload_ring.EndFrame();  // 本帧区段之后插入fence
+        profiler.EndFrame();
 
-        glfwSwapBuffers(window);  // Swap buffers
+        if (headless) {
+            glEndQuery(GL_TIME_ELAPSED);
+            glFlush();
+            FrameSample sample;
+            sample.cpuMs = (float)((glfwGetTime() - frame_start) * 1000.0);
+            sample.gpuMs = -1.0f;
+            sample.triangles = triangles_drawn;
+            sample.drawCalls = draw_calls;
+            headless_samples.push_back(sample);
+            if (replay_frame >= 2) {
+                GLuint64 elapsed_ns = 0;
+                glGetQueryObjectui64v(time_queries[(replay_frame - 2) % 3], GL_QUERY_RESULT, &elapsed_ns);
+                headless_samples[replay_frame - 2].gpuMs = elapsed_ns / 1000000.0f;
+            }
+        }
+        else {
+            glfwSwapBuffers(window);  // Swap buffers
+        }
+        if (camera_replay)
+            replay_frame++;
         glfwPollEvents();  // 轮询事件
 
         
     } // Check if the ESC key was pressed or the window was closed
     while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-        glfwWindowShouldClose(window) == 0);
+        glfwWindowShouldClose(window) == 0 &&
+        !(headless && replay_frame >= headless_frames) &&
+        !(camera_replay && !headless && replay_frame >= camera_path.GetFrameCount()));
+    if (camera_record_path && camera_path.Save(camera_record_path))
+        printf("Recorded %zu frames to %s\n", camera_path.Size(), camera_record_path);
+    finish_trace();
+    if (frame_stats.GetCount() > 0) {
+        run_summary = frame_stats.GetSummary();
+        printf("%zu frames, ms: mean %.2f  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f  stutters %zu  >33 ms %zu\n",
+            run_summary.frames, run_summary.meanMs, run_summary.p50Ms, run_summary.p95Ms, run_summary.p99Ms,
+            run_summary.maxMs, run_summary.stutters, run_summary.slowFrames);
+        if (frame_stats.WriteJson(frame_stats_path))
+            printf("Wrote frame time histogram to %s\n", frame_stats_path);
+    }
+    if (headless) {
+        // 最后两帧的GPU时间还没取
+        for (int f = replay_frame - 2 < 0 ? 0 : replay_frame - 2; f < replay_frame; f++) {
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(time_queries[f % 3], GL_QUERY_RESULT, &elapsed_ns);
+            headless_samples[f].gpuMs = elapsed_ns / 1000000.0f;
+        }
+        FrameReportInfo report_info;
+        report_info.mode = render_mode_names[render_mode];
+        report_info.renderer = (const char*)glGetString(GL_RENDERER);
+        report_info.width = window_width;
+        report_info.height = window_height;
+        report_written = WriteFrameReport(headless_report, report_info, headless_samples);
+        if (report_written)
+            printf("Wrote %d frames to %s\n", replay_frame, headless_report);
+        glDeleteQueries(3, time_queries);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &headless_fbo);
+        glDeleteRenderbuffers(2, headless_renderbuffers);
+    }
     // 清理VAO和着色器
-    glDeleteBuffers(1, &vertexbuffer);
+    if (vertexbuffer)
+        glDeleteBuffers(1, &vertexbuffer);
+    if (packed_vertexbuffer)
+        glDeleteBuffers(1, &packed_vertexbuffer);
     //glDeleteBuffers(1, &colorbuffer);
     // glDeleteBuffers(1, &uvbuffer);
     glDeleteBuffers(1, &elementbuffer);
+    glDeleteTextures(1, &heightTexture);
+    glDeleteTextures(1, &normalTexture);
+    chunk_batcher.Shutdown();
     glDeleteProgram(programID);
+    glDeleteProgram(heightProgramID);
+    glDeleteProgram(cdlodProgramID);
+    glDeleteProgram(clipmapProgramID);
+    streamer.Shutdown();
+    glDeleteProgram(streamProgramID);
+    if (vs_query_supported)
+        glDeleteQueries(2, vs_queries);
+    profiler.Shutdown();
     // glDeleteTextures(1, &Texture);
     glDeleteVertexArrays(1, &VertexArrayID);
 
+    ImGui_ImplOpenGL3_SetUploadFn(NULL, NULL);
+    upload_ring.Shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -678,6 +1517,6 @@ int main()
     glfwTerminate();
     
 
-    return 0;
+    return report_written ? 0 : 1;
 }
 
@@ -11,6 +11,11 @@
 
     #define BMPLIB_SILENT
     if you want bmplib to stop writing exceptions to stderr
+
+    #define BMPLIB_NO_SIMD
+    if you want Read() to swizzle BGR(A) -> RGB(A) without SSSE3.
+    Builds targeting SSSE3 (-mssse3, /arch:AVX) always use it; MSVC x64 builds without such
+    flags only guarantee SSE2 and check the CPU with cpuid once before using SSSE3.
 */
 
 #pragma once
@@ -18,6 +23,16 @@
 #include <fstream>
 #include <string.h>
 
+#if !defined(BMPLIB_NO_SIMD) && (defined(__SSSE3__) || defined(__AVX__))
+#define BMPLIB_SSSE3
+#include <tmmintrin.h>
+#elif !defined(BMPLIB_NO_SIMD) && defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#define BMPLIB_SSSE3
+#define BMPLIB_SSSE3_CPUID
+#include <tmmintrin.h>
+#include <intrin.h>
+#endif
+
 #define BMPLIB_VERSION 0.602
 
 namespace BMPlib
@@ -90,7 +105,8 @@ namespace BMPlib
             return;
         }
 
-        void ReInitialize(const std::size_t& width, const std::size_t& height, const BMP::COLOR_MODE& colorMode = BMP::COLOR_MODE::RGB)
+        // Set clear to false to skip blacking out the new pixelbuffer when every pixel gets written anyway
+        void ReInitialize(const std::size_t& width, const std::size_t& height, const BMP::COLOR_MODE& colorMode = BMP::COLOR_MODE::RGB, bool clear = true)
         {
             if ((!width) || (!height)) ThrowException("Bad image dimensions!");
 
@@ -131,7 +147,8 @@ namespace BMPlib
             }
 
             // Make image black
-            memset(pixelbfr, 0, sizeofPxlbfr);
+            if (clear)
+                memset(pixelbfr, 0, sizeofPxlbfr);
 
             isInitialized = true;
             return;
@@ -491,7 +508,107 @@ namespace BMPlib
         }
 
         // Will read a bmp image
+        // Reads whole scanlines straight into the pixel buffer and swizzles them in place.
+        // Handles bottom-up and top-down files with 8 (palettized, read as BW), 24 and 32 bit depth.
+        // 24/32 bit results are byte-identical to ReadPerByte().
         bool Read(std::string filename)
+        {
+            std::ifstream bs;
+            FileLayout layout;
+            if (!OpenPixelArray(bs, filename, layout))
+                return false;
+
+            ReInitialize(layout.width, layout.height, layout.colorMode, false);
+
+            const std::size_t rowBytes = width * numChannelsPXBF;
+            const std::size_t paddingSize = layout.fileRowBytes - rowBytes;
+            for (std::size_t i = 0; i < height; i++)
+            {
+                // pixelbfr is always top-down
+                const std::size_t y = layout.topDown ? i : height - 1 - i;
+                byte* row = pixelbfr + y * rowBytes;
+                if (!bs.read((char*)row, rowBytes))
+                    return false;
+                if (paddingSize > 0)
+                    bs.ignore(paddingSize);
+
+                switch (layout.bitDepth)
+                {
+                case 8:
+                    for (std::size_t x = 0; x < width; x++)
+                        row[x] = layout.palette[row[x]];
+                    break;
+                case 24:
+                    SwizzleBGR(row, width);
+                    break;
+                case 32:
+                    SwizzleBGRA(row, width);
+                    break;
+                }
+            }
+
+            bs.close();
+            return true;
+        }
+
+        // Will read a bmp image as non-color height data, straight into a BW pixel buffer.
+        // Same result as Read() followed by ConvertTo(COLOR_MODE::BW, true), but the only
+        // memory besides the 1 byte/pixel buffer is a single scanline.
+        bool ReadAsHeightfield(std::string filename)
+        {
+            std::ifstream bs;
+            FileLayout layout;
+            if (!OpenPixelArray(bs, filename, layout))
+                return false;
+
+            ReInitialize(layout.width, layout.height, COLOR_MODE::BW, false);
+
+            // Same rounding as ConvertTo() for every possible r+g+b
+            byte average[3 * 255 + 1];
+            for (std::size_t i = 0; i < sizeof(average); i++)
+                average[i] = (byte)(i * 0.33333333);
+
+            byte* scanline;
+            try
+            {
+                scanline = new byte[layout.fileRowBytes];
+            }
+            catch (std::bad_alloc& e)
+            {
+                ThrowException(std::string("Can't allocate memory for scanline buffer!") + e.what());
+                return false;
+            }
+
+            const std::size_t stride = layout.bitDepth / 8;
+            bool ok = true;
+            for (std::size_t i = 0; (i < height) && ok; i++)
+            {
+                const std::size_t y = layout.topDown ? i : height - 1 - i;
+                byte* row = pixelbfr + y * width;
+                if (!bs.read((char*)scanline, layout.fileRowBytes))
+                {
+                    // The last scanline's padding is allowed to be missing
+                    ok = (std::size_t)bs.gcount() >= width * stride;
+                    bs.clear();
+                }
+
+                const byte* src = scanline;
+                if (stride == 1)
+                    for (std::size_t x = 0; x < width; x++)
+                        row[x] = layout.palette[src[x]];
+                else
+                    for (std::size_t x = 0; x < width; x++, src += stride)
+                        row[x] = average[src[0] + src[1] + src[2]];
+            }
+
+            delete[] scanline;
+            bs.close();
+            return ok;
+        }
+
+        // Reference reader that fetches every channel with its own stream read.
+        // Slow; kept to validate and benchmark Read().
+        bool ReadPerByte(std::string filename)
         {
             std::ifstream bs;
             bs.open(filename, std::ifstream::binary);
@@ -620,6 +737,152 @@ namespace BMPlib
         }
 
     private:
+        // Where and how the pixel array of a file is stored
+        struct FileLayout
+        {
+            std::size_t width;
+            std::size_t height;
+            bool topDown;
+            byte2 bitDepth;
+            COLOR_MODE colorMode;
+            std::size_t fileRowBytes; // scanline length including padding
+            byte palette[256];        // 8 bit only: palette index ==> gray value
+        };
+
+        // Parses the headers (and palette) and leaves bs at the start of the pixel array
+        static bool OpenPixelArray(std::ifstream& bs, const std::string& filename, FileLayout& layout)
+        {
+            bs.open(filename, std::ifstream::binary);
+            if (!bs.good())
+                return false;
+
+            // Both headers in one go (14 byte file header + 40 byte BITMAPINFOHEADER)
+            byte header[54];
+            if (!bs.read((char*)header, sizeof(header)))
+                return false;
+            if (LoadLE<byte2>(header + 0) != 0x4D42)
+                return false;
+
+            const byte4 offsetPixelArray = LoadLE<byte4>(header + 10);
+            const byte4 dibHeadLen = LoadLE<byte4>(header + 14);
+            const int imgWidth = (int)LoadLE<byte4>(header + 18);
+            const int imgHeight = (int)LoadLE<byte4>(header + 22);
+            byte4 colorsInPalette = LoadLE<byte4>(header + 46);
+
+            // Negative height means the rows are stored top-down
+            layout.topDown = imgHeight < 0;
+            layout.width = imgWidth > 0 ? (std::size_t)imgWidth : 0;
+            layout.height = (std::size_t)(layout.topDown ? -(long long)imgHeight : imgHeight);
+            if ((layout.width == 0) || (layout.height == 0))
+                return false;
+
+            layout.bitDepth = LoadLE<byte2>(header + 28);
+            switch (layout.bitDepth)
+            {
+            case 8:
+                layout.colorMode = COLOR_MODE::BW;
+                break;
+            case 24:
+                layout.colorMode = COLOR_MODE::RGB;
+                break;
+            case 32:
+                layout.colorMode = COLOR_MODE::RGBA;
+                break;
+            default:
+                return false;
+            }
+            layout.fileRowBytes = (layout.width * (layout.bitDepth / 8) + 3) & ~(std::size_t)3;
+
+            // 8 bit images carry a BGRA palette right behind the DIB header
+            if (layout.bitDepth == 8)
+            {
+                if ((colorsInPalette == 0) || (colorsInPalette > 256))
+                    colorsInPalette = 256;
+                byte paletteBGRA[256 * 4];
+                memset(paletteBGRA, 0, sizeof(paletteBGRA));
+                bs.seekg(14 + dibHeadLen);
+                if (!bs.read((char*)paletteBGRA, colorsInPalette * 4))
+                    return false;
+                for (std::size_t i = 0; i < 256; i++)
+                    layout.palette[i] = (byte)((paletteBGRA[i * 4 + 0] + paletteBGRA[i * 4 + 1] + paletteBGRA[i * 4 + 2]) / 3);
+            }
+
+            bs.seekg(offsetPixelArray);
+            return bs.good();
+        }
+
+        template<typename T>
+        static T LoadLE(const byte* p)
+        {
+            T t = 0;
+            for (std::size_t i = 0; i < sizeof(T); i++)
+                t |= (T)((T)p[i] << (i * 8));
+            return t;
+        }
+
+#ifdef BMPLIB_SSSE3
+        // pshufb is SSSE3, which x64 alone does not promise
+        static bool HasSSSE3()
+        {
+#ifdef BMPLIB_SSSE3_CPUID
+            static const bool ssse3 = []() {
+                int info[4];
+                __cpuid(info, 1);
+                return (info[2] & (1 << 9)) != 0;
+            }();
+            return ssse3;
+#else
+            return true;
+#endif
+        }
+#endif
+
+        // In-place B-G-R ==> R-G-B for numPx pixels
+        static void SwizzleBGR(byte* px, std::size_t numPx)
+        {
+            std::size_t i = 0;
+            const std::size_t numBytes = numPx * 3;
+#ifdef BMPLIB_SSSE3
+            // 5 pixels per 16 byte load. The 16th byte maps onto itself, so the overlapping
+            // store writes it back unchanged before the next iteration loads it again.
+            const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+            const std::size_t simdBytes = HasSSSE3() ? numBytes : 0;
+            for (; i + 16 <= simdBytes; i += 15)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(px + i));
+                _mm_storeu_si128((__m128i*)(px + i), _mm_shuffle_epi8(v, mask));
+            }
+#endif
+            for (; i < numBytes; i += 3)
+            {
+                byte b = px[i];
+                px[i] = px[i + 2];
+                px[i + 2] = b;
+            }
+        }
+
+        // In-place B-G-R-A ==> R-G-B-A for numPx pixels
+        static void SwizzleBGRA(byte* px, std::size_t numPx)
+        {
+            std::size_t i = 0;
+            const std::size_t numBytes = numPx * 4;
+#ifdef BMPLIB_SSSE3
+            const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+            const std::size_t simdBytes = HasSSSE3() ? numBytes : 0;
+            for (; i + 16 <= simdBytes; i += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(px + i));
+                _mm_storeu_si128((__m128i*)(px + i), _mm_shuffle_epi8(v, mask));
+            }
+#endif
+            for (; i < numBytes; i += 4)
+            {
+                byte b = px[i];
+                px[i] = px[i + 2];
+                px[i + 2] = b;
+            }
+        }
+
         void ThrowException(const std::string msg) const
         {
             #ifndef BMPLIB_SILENT
@@ -0,0 +1,1011 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BMPlib.h"
+#include "loadShader.h"
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "terrain_mesh.hpp"
+#include "terrain_cdlod.hpp"
+#include "terrain_clipmap.hpp"
+#include "terrain_cull.hpp"
+#include "terrain_horizon.hpp"
+#include "soft_occlusion.hpp"
+#include "terrain_normals.hpp"
+#include "terrain_tiles.hpp"
+#include "terrain_stream.hpp"
+#include "terrain_multidraw.hpp"
+#include "trace.hpp"
+#include "benchmark.hpp"
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+static double ElapsedMs(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// Fills a size x size R16 heightfield with a cheap deterministic pattern
+static void MakeSyntheticHeights(int size, Heightfield& heights)
+{
+	heights.width = heights.height = size;
+	heights.format = HEIGHT_FORMAT::R16;
+	heights.r16.resize((size_t)size * size);
+	unsigned int seed = 12345;
+	for (size_t i = 0; i < heights.r16.size(); i++) {
+		seed = seed * 1664525u + 1013904223u;
+		heights.r16[i] = (unsigned short)(seed >> 16);
+	}
+}
+
+// Fills a size x size R16 heightfield with ridges and valleys
+static void MakeMountainHeights(int size, Heightfield& heights)
+{
+	heights.width = heights.height = size;
+	heights.format = HEIGHT_FORMAT::R16;
+	heights.r16.resize((size_t)size * size);
+	ParallelFor(0, size, 0, [&](int rowBegin, int rowEnd) {
+		for (int r = rowBegin; r < rowEnd; r++) {
+			for (int c = 0; c < size; c++) {
+				float h = 0.45f + 0.25f * sinf(r * 0.0061f) * cosf(c * 0.0053f)
+					+ 0.2f * fabsf(sinf(r * 0.0131f + c * 0.0079f))
+					+ 0.08f * sinf(r * 0.043f) * sinf(c * 0.037f);
+				h = h < 0.0f ? 0.0f : (h > 1.0f ? 1.0f : h);
+				heights.r16[(size_t)r * size + c] = (unsigned short)(h * 65535.0f);
+			}
+		}
+	});
+}
+
+// mesh [size]: TerrainMeshBuilder vertex + index build time for 1, 2, 4 and all threads
+static int BenchMesh(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 4096;
+	if (size < 2) {
+		printf("mesh: bad size\n");
+		return 1;
+	}
+	Heightfield heights;
+	MakeSyntheticHeights(size, heights);
+	const double mpixels = (double)size * size / 1e6;
+
+	int threadCounts[4] = { 1, 2, 4, ResolveThreadCount(0) };
+	std::vector<glm::vec3> vertices;
+	TerrainIndexBuffer indices;
+	printf("mesh %dx%d (%.1f Mpixel)\n", size, size, mpixels);
+	for (int i = 0; i < 4; i++) {
+		if (i == 3 && (threadCounts[3] == 1 || threadCounts[3] == 2 || threadCounts[3] == 4))
+			break;
+		TerrainMeshBuilder builder(threadCounts[i]);
+		builder.Build(heights, vertices, indices);  // warm-up, also sizes the outputs
+
+		const int runs = 3;
+		double best = 1e30;
+		for (int r = 0; r < runs; r++) {
+			BenchClock::time_point start = BenchClock::now();
+			builder.Build(heights, vertices, indices);
+			double ms = ElapsedMs(start);
+			best = ms < best ? ms : best;
+		}
+		printf("  threads %2d: %8.2f ms  %6.2f ms/Mpixel\n", threadCounts[i], best, best / mpixels);
+	}
+	return 0;
+}
+
+// bmp [file]: BMP::Read (scanline + SIMD) against BMP::ReadPerByte, in MB/s of pixel data
+static int BenchBmp(int argc, char** argv)
+{
+	const char* path = argc > 0 ? argv[0] : "res/terrain.bmp";
+	BMPlib::BMP fast, slow;
+
+	BenchClock::time_point start = BenchClock::now();
+	if (!slow.ReadPerByte(path)) {
+		printf("bmp: can't read %s\n", path);
+		return 1;
+	}
+	double slowMs = ElapsedMs(start);
+
+	double fastMs = 1e30;
+	for (int r = 0; r < 3; r++) {
+		start = BenchClock::now();
+		if (!fast.Read(path)) {
+			printf("bmp: can't read %s\n", path);
+			return 1;
+		}
+		double ms = ElapsedMs(start);
+		fastMs = ms < fastMs ? ms : fastMs;
+	}
+
+	const double mb = fast.GetSize() / (1024.0 * 1024.0);
+	bool identical = fast.GetSize() == slow.GetSize() &&
+		memcmp(fast.GetPixelBuffer(), slow.GetPixelBuffer(), fast.GetSize()) == 0;
+	printf("bmp %s: %zux%zu, %.1f MB of pixels\n", path, fast.GetWidth(), fast.GetHeight(), mb);
+	printf("  ReadPerByte: %8.2f ms  %8.1f MB/s\n", slowMs, mb / (slowMs / 1000.0));
+	printf("  Read:        %8.2f ms  %8.1f MB/s\n", fastMs, mb / (fastMs / 1000.0));
+	printf("  pixel buffers %s\n", identical ? "identical" : "DIFFER");
+
+	// Heightfield path: one pass into 1 byte/pixel versus Read + ConvertTo(BW)
+	BMPlib::BMP converted, heights;
+	start = BenchClock::now();
+	converted.Read(path);
+	converted.ConvertTo(BMPlib::BMP::COLOR_MODE::BW, true);
+	double convertMs = ElapsedMs(start);
+	start = BenchClock::now();
+	heights.ReadAsHeightfield(path);
+	double heightsMs = ElapsedMs(start);
+	bool sameHeights = heights.GetSize() == converted.GetSize() &&
+		memcmp(heights.GetPixelBuffer(), converted.GetPixelBuffer(), heights.GetSize()) == 0;
+	printf("  Read + ConvertTo(BW): %8.2f ms\n", convertMs);
+	printf("  ReadAsHeightfield:    %8.2f ms  heights %s\n", heightsMs, sameHeights ? "identical" : "DIFFER");
+	return identical && sameHeights ? 0 : 1;
+}
+
+// cdlod [frames]: quadtree selection cost for 1k^2 .. 32k^2 maps along a low diagonal flight.
+// Leaf bounds are synthesized directly so the large maps need no heightfield in memory.
+static int BenchCdlod(int argc, char** argv)
+{
+	int frames = argc > 0 ? atoi(argv[0]) : 200;
+	if (frames < 1) {
+		printf("cdlod: bad frame count\n");
+		return 1;
+	}
+	const int leafSize = 32;
+	const float spacing = 1.0f;
+	printf("cdlod selection, leaf %d, %d frames\n", leafSize, frames);
+	for (int size = 1024; size <= 32768; size *= 2) {
+		const int leaves = (size - 2) / leafSize + 1;
+		std::vector<float> leafMin((size_t)leaves * leaves), leafMax((size_t)leaves * leaves);
+		unsigned int seed = 12345;
+		for (size_t i = 0; i < leafMin.size(); i++) {
+			seed = seed * 1664525u + 1013904223u;
+			leafMin[i] = (float)(seed >> 20) * 0.05f;
+			leafMax[i] = leafMin[i] + (float)((seed >> 8) & 0xff) * 0.1f;
+		}
+		CdlodTerrain terrain;
+		terrain.InitBounds(size + 1, size + 1, leafSize, spacing, leafMin, leafMax);
+
+		size_t visited = 0, selected = 0;
+		BenchClock::time_point start = BenchClock::now();
+		for (int f = 0; f < frames; f++) {
+			float t = (float)f / frames * size * spacing;
+			terrain.Select(glm::vec3(t, 150.0f, t));
+			visited += terrain.GetNodesVisited();
+			selected += terrain.GetSelectedCount();
+		}
+		double ms = ElapsedMs(start);
+		printf("  %5dx%-5d levels %2d: %8.1f nodes visited  %7.1f selected  %8.3f ms/frame\n", size, size,
+			terrain.GetLevelCount(), (double)visited / frames, (double)selected / frames, ms / frames);
+	}
+	return 0;
+}
+
+// clipmap [frames] [speed]: flies a scripted path over a 4096^2 map and checks that the bytes
+// uploaded per frame stay within the L-strip bound, O(levelSize * distance moved) per level
+static int BenchClipmap(int argc, char** argv)
+{
+	int frames = argc > 0 ? atoi(argv[0]) : 1000;
+	float speed = argc > 1 ? (float)atof(argv[1]) : 4.0f;   // samples per frame
+	if (frames < 2 || speed <= 0.0f) {
+		printf("clipmap: bad arguments\n");
+		return 1;
+	}
+	const int levelCount = 6, levelSize = 256, size = 4096;
+	Heightfield heights;
+	MakeSyntheticHeights(size, heights);
+	ClipmapTerrain clipmap;
+	clipmap.Init(heights, levelCount, levelSize, 1.0f, false);
+
+	// Origins snap to even samples, so a level can shift by speed / 2^l rounded up, plus 2
+	size_t bound = 0;
+	for (int l = 0; l < levelCount; l++) {
+		size_t shift = (size_t)ceilf(speed / (float)(1 << l)) + 2;
+		bound += 2 * shift * (size_t)(levelSize - 1) * sizeof(unsigned short);
+	}
+
+	size_t total = 0, worst = 0;
+	glm::vec3 camera(size * 0.25f, 100.0f, size * 0.25f);
+	clipmap.Update(camera);  // first frame fills every level
+	size_t initial = clipmap.GetBytesUploaded();
+	BenchClock::time_point start = BenchClock::now();
+	for (int f = 1; f < frames; f++) {
+		// Curving flight, always moving speed samples per frame
+		float heading = f * 0.01f;
+		camera += glm::vec3(cosf(heading), 0.0f, sinf(heading)) * speed;
+		clipmap.Update(camera);
+		total += clipmap.GetBytesUploaded();
+		worst = clipmap.GetBytesUploaded() > worst ? clipmap.GetBytesUploaded() : worst;
+	}
+	double ms = ElapsedMs(start);
+	bool bounded = worst <= bound;
+	printf("clipmap %d levels x %d^2 over %dx%d, %d frames at %.1f samples/frame\n",
+		levelCount, levelSize, size, size, frames, speed);
+	printf("  map %.1f MB, clipmap texture %.2f MB, first frame %.1f KB\n",
+		heights.ByteSize() / (1024.0 * 1024.0), clipmap.GetTextureBytes() / (1024.0 * 1024.0), initial / 1024.0);
+	printf("  per frame: avg %.1f KB  max %.1f KB  bound %.1f KB  update %.3f ms\n",
+		total / 1024.0 / (frames - 1), worst / 1024.0, bound / 1024.0, ms / (frames - 1));
+	printf("  uploads %s\n", bounded ? "bounded" : "EXCEED BOUND");
+	return bounded ? 0 : 1;
+}
+
+// cull [chunks]: CullChunks (SoA, SSE) against the per-chunk AabbInFrustum loop
+static int BenchCull(int argc, char** argv)
+{
+	int chunks = argc > 0 ? atoi(argv[0]) : 100000;
+	if (chunks < 1) {
+		printf("cull: bad chunk count\n");
+		return 1;
+	}
+	// Square grid of 16x16 chunks with random height ranges
+	const int side = (int)ceil(sqrt((double)chunks));
+	const float chunkSize = 16.0f;
+	ChunkBounds bounds;
+	bounds.Resize(chunks);
+	unsigned int seed = 12345;
+	for (int i = 0; i < chunks; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		float lo = (float)(seed >> 24), hi = lo + (float)((seed >> 16) & 0xff);
+		float x = (i / side) * chunkSize, z = (i % side) * chunkSize;
+		bounds.Set(i, glm::vec3(x, lo, z), glm::vec3(x + chunkSize, hi, z + chunkSize));
+	}
+
+	const int views = 64, runs = 20;
+	const float extent = side * chunkSize;
+	std::vector<unsigned int> visible;
+	double simdMs = 0.0, scalarMs = 0.0;
+	size_t visibleTotal = 0;
+	bool same = true;
+	for (int v = 0; v < views; v++) {
+		// Cameras over the middle of the map, turning around
+		float angle = v * 6.2831853f / views;
+		glm::vec3 eye(extent * 0.5f, 300.0f, extent * 0.5f);
+		glm::vec3 dir(cosf(angle), -0.3f, sinf(angle));
+		glm::mat4 mvp = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, extent * 0.5f) *
+			glm::lookAt(eye, eye + dir, glm::vec3(0, 1, 0));
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(mvp, planes);
+
+		BenchClock::time_point start = BenchClock::now();
+		for (int r = 0; r < runs; r++)
+			CullChunks(planes, bounds, visible);
+		simdMs += ElapsedMs(start);
+		visibleTotal += visible.size();
+
+		size_t scalarVisible = 0;
+		start = BenchClock::now();
+		for (int r = 0; r < runs; r++) {
+			scalarVisible = 0;
+			for (int i = 0; i < chunks; i++) {
+				glm::vec3 lo(bounds.minX[i], bounds.minY[i], bounds.minZ[i]);
+				glm::vec3 hi(bounds.maxX[i], bounds.maxY[i], bounds.maxZ[i]);
+				scalarVisible += AabbInFrustum(planes, lo, hi) ? 1 : 0;
+			}
+		}
+		scalarMs += ElapsedMs(start);
+		same = same && scalarVisible == visible.size();
+	}
+	printf("cull %d chunks, %d views\n", chunks, views);
+	printf("  visible:       %8.1f chunks (%.1f%%)\n", (double)visibleTotal / views, 100.0 * visibleTotal / views / chunks);
+	printf("  CullChunks:    %8.3f ms  %8.1f Mchunks/s\n", simdMs / (views * runs), (double)chunks * views * runs / simdMs / 1000.0);
+	printf("  AabbInFrustum: %8.3f ms  %8.1f Mchunks/s\n", scalarMs / (views * runs), (double)chunks * views * runs / scalarMs / 1000.0);
+	printf("  results %s\n", same ? "identical" : "DIFFER");
+	return same ? 0 : 1;
+}
+
+// horizon [size]: share of frustum-visible chunks the horizon rejects from low cameras
+// in the valleys of a mountainous map, and the time the pass takes
+static int BenchHorizon(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 2048;
+	if (size < 128) {
+		printf("horizon: bad size\n");
+		return 1;
+	}
+	const float spacing = 1.0f, heightScale = 300.0f;
+	Heightfield heights;
+	MakeMountainHeights(size, heights);
+	TerrainPatchSet chunks;
+	BuildGridPatches(size, size, 65, chunks);
+	ChunkBounds bounds;
+	ComputePatchBounds(heights, chunks, spacing, heightScale, bounds);
+	HorizonCuller culler;
+	culler.BuildOccluders(heights, 8, spacing, heightScale);
+	culler.SetOccluderDistance(256.0f * spacing);
+
+	const int views = 64;
+	std::vector<unsigned int> candidates, visible;
+	size_t tested = 0, rejected = 0, trianglesBefore = 0, trianglesAfter = 0;
+	double ms = 0.0;
+	unsigned int seed = 12345;
+	for (int v = 0; v < views; v++) {
+		// Lowest of a few random spots, 5 units above the ground, looking along a random heading
+		int bestRow = 0, bestCol = 0;
+		float best = 1e30f;
+		for (int k = 0; k < 16; k++) {
+			seed = seed * 1664525u + 1013904223u;
+			int r = (int)((seed >> 8) % (unsigned int)size);
+			seed = seed * 1664525u + 1013904223u;
+			int c = (int)((seed >> 8) % (unsigned int)size);
+			if (heights.Sample(r, c) < best) {
+				best = heights.Sample(r, c);
+				bestRow = r;
+				bestCol = c;
+			}
+		}
+		glm::vec3 eye(bestRow * spacing, best * heightScale + 5.0f, bestCol * spacing);
+		float angle = v * 2.3999632f;
+		glm::mat4 mvp = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, size * spacing * 1.5f) *
+			glm::lookAt(eye, eye + glm::vec3(cosf(angle), 0.0f, sinf(angle)), glm::vec3(0, 1, 0));
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(mvp, planes);
+		CullChunks(planes, bounds, candidates);
+
+		BenchClock::time_point start = BenchClock::now();
+		culler.Cull(eye, bounds, candidates, visible);
+		ms += ElapsedMs(start);
+		tested += culler.GetTested();
+		rejected += culler.GetRejected();
+		for (size_t i = 0; i < candidates.size(); i++)
+			trianglesBefore += chunks.patches[candidates[i]].indexCount / 3;
+		for (size_t i = 0; i < visible.size(); i++)
+			trianglesAfter += chunks.patches[visible[i]].indexCount / 3;
+	}
+	printf("horizon %dx%d, %zu chunks, %zu occluder cells, %d valley views\n",
+		size, size, bounds.Count(), (size_t)((size - 2) / 8 + 1) * ((size - 2) / 8 + 1), views);
+	printf("  frustum-visible: %8.1f chunks  %10.0f triangles\n", (double)tested / views, (double)trianglesBefore / views);
+	printf("  after horizon:   %8.1f chunks  %10.0f triangles  (%.1f%% chunks rejected)\n",
+		(double)(tested - rejected) / views, (double)trianglesAfter / views, tested ? 100.0 * rejected / tested : 0.0);
+	printf("  horizon pass:    %8.3f ms\n", ms / views);
+	return 0;
+}
+
+// occlusion [size] [threads]: software depth buffer rasterisation (tris/ms) and AABB query
+// throughput (queries/ms) from valley cameras over a mountainous map, no GPU needed
+static int BenchOcclusion(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 2048;
+	int threads = argc > 1 ? atoi(argv[1]) : 0;
+	if (size < 128) {
+		printf("occlusion: bad size\n");
+		return 1;
+	}
+	const float spacing = 1.0f, heightScale = 300.0f;
+	Heightfield heights;
+	MakeMountainHeights(size, heights);
+	TerrainPatchSet chunks;
+	BuildGridPatches(size, size, 65, chunks);
+	ChunkBounds bounds;
+	ComputePatchBounds(heights, chunks, spacing, heightScale, bounds);
+	SoftwareOcclusion occlusion(256, 128, threads);
+	occlusion.BuildOccluders(heights, 16, spacing, heightScale);
+
+	const int views = 64;
+	std::vector<unsigned int> candidates, visible;
+	size_t rasterized = 0, tested = 0, rejected = 0;
+	double renderMs = 0.0, queryMs = 0.0;
+	for (int v = 0; v < views; v++) {
+		// Cameras low over the map centre, turning around and looking slightly down
+		float angle = v * 2.3999632f;
+		int r = size / 2 + (int)(size * 0.3f * cosf(v * 0.7f)), c = size / 2 + (int)(size * 0.3f * sinf(v * 0.7f));
+		glm::vec3 eye(r * spacing, heights.Sample(r, c) * heightScale + 5.0f, c * spacing);
+		glm::mat4 mvp = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, size * spacing * 1.5f) *
+			glm::lookAt(eye, eye + glm::vec3(cosf(angle), -0.1f, sinf(angle)), glm::vec3(0, 1, 0));
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(mvp, planes);
+		CullChunks(planes, bounds, candidates);
+
+		BenchClock::time_point start = BenchClock::now();
+		occlusion.Render(mvp);
+		renderMs += ElapsedMs(start);
+		rasterized += occlusion.GetTrianglesRasterized();
+
+		start = BenchClock::now();
+		occlusion.Cull(bounds, candidates, visible);
+		queryMs += ElapsedMs(start);
+		tested += occlusion.GetTested();
+		rejected += occlusion.GetRejected();
+	}
+	printf("occlusion %dx%d, %dx%d depth buffer, %zu occluder triangles, %d threads\n", size, size,
+		occlusion.GetWidth(), occlusion.GetHeight(), occlusion.GetOccluderTriangles(), ResolveThreadCount(threads));
+	printf("  render:  %8.3f ms  %8.1f tris/ms (%.0f tris after clipping)\n",
+		renderMs / views, rasterized / renderMs, (double)rasterized / views);
+	printf("  queries: %8.3f ms  %8.1f queries/ms\n", queryMs / views, tested / queryMs);
+	printf("  %.1f of %.1f frustum-visible chunks rejected (%.1f%%)\n",
+		(double)rejected / views, (double)tested / views, tested ? 100.0 * rejected / tested : 0.0);
+
+	// Render splits work three times per frame: cost of one empty split with fresh threads and with the pool
+	const int dispatches = 200;
+	volatile int sink = 0;
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < dispatches; i++)
+		ParallelFor(0, 1024, threads, [&](int begin, int end) { sink += end - begin; });
+	const double spawnUs = ElapsedMs(start) * 1000.0 / dispatches;
+	WorkerPool pool(threads);
+	start = BenchClock::now();
+	for (int i = 0; i < dispatches; i++)
+		pool.ParallelFor(0, 1024, [&](int begin, int end) { sink += end - begin; });
+	const double poolUs = ElapsedMs(start) * 1000.0 / dispatches;
+	printf("  dispatch: %.1f us with new threads, %.1f us with the worker pool (x3 per frame)\n", spawnUs, poolUs);
+	return 0;
+}
+
+// vcache [size]: ACMR/ATVR of row-major against column-strip index order (FIFO cache simulation),
+// as triangle lists and as restart-separated strips, with their index memory and the
+// vertex shader invocations that gives for one full-grid frame
+static int BenchVertexCache(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 1024;
+	if (size < 2) {
+		printf("vcache: bad size\n");
+		return 1;
+	}
+	const GRID_ORDER orders[2] = { GRID_ORDER::ROWS, GRID_ORDER::COLUMN_STRIPS };
+	const char* names[2] = { "rows", "column strips" };
+	const GRID_PRIMITIVE primitives[2] = { GRID_PRIMITIVE::TRIANGLES, GRID_PRIMITIVE::STRIPS };
+	const char* primitiveNames[2] = { "triangles", "strips" };
+	const int caches[3] = { 16, 24, 32 };
+	const size_t triangles = (size_t)(size - 1) * (size - 1) * 2;
+	printf("vcache %dx%d, %zu triangles\n", size, size, triangles);
+	for (int p = 0; p < 2; p++) {
+		for (int o = 0; o < 2; o++) {
+			TerrainIndexBuffer grid;
+			TerrainPatchSet chunks;
+			BuildGridIndices(size, size, grid, 0, orders[o], primitives[p]);
+			BuildGridPatches(size, size, 65, chunks, orders[o], primitives[p]);
+			printf(" %s, %s: grid %.2f MB, 65^2 chunks %.2f MB of indices\n", primitiveNames[p], names[o],
+				grid.ByteSize() / (1024.0 * 1024.0), chunks.indices.size() * sizeof(GLushort) / (1024.0 * 1024.0));
+			for (int c = 0; c < 3; c++) {
+				VertexCacheStats full = AnalyzeVertexCache(grid, (size_t)size * size, caches[c]);
+				VertexCacheStats patched = AnalyzeVertexCache(chunks, caches[c]);
+				printf("  FIFO %2d: grid ACMR %.3f ATVR %.3f  65^2 chunks ACMR %.3f ATVR %.3f  VS/frame %10.0f\n",
+					caches[c], full.acmr, full.atvr, patched.acmr, patched.atvr, (double)patched.acmr * triangles);
+			}
+		}
+	}
+	return 0;
+}
+
+// vformat [size]: memory of the vec3 vertex buffer against the packed layouts, build time,
+// and the vertex fetch traffic of one full-grid frame (post-transform cache misses x vertex size)
+static int BenchVertexFormat(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 2048;
+	if (size < 2) {
+		printf("vformat: bad size\n");
+		return 1;
+	}
+	Heightfield heights;
+	MakeSyntheticHeights(size, heights);
+	TerrainMeshBuilder builder;
+	TerrainPatchSet chunks;
+	BuildGridPatches(size, size, 65, chunks, GRID_ORDER::COLUMN_STRIPS);
+	const double fetches = AnalyzeVertexCache(chunks).acmr * (double)(size - 1) * (size - 1) * 2;
+
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> chunkVertices;
+	PackedVertexBuffer packedGrid, packedChunks;
+	BenchClock::time_point start = BenchClock::now();
+	builder.BuildVertices(heights, vertices);
+	ReorderVerticesToPatches(vertices, size, chunks, chunkVertices);
+	double floatMs = ElapsedMs(start);
+	start = BenchClock::now();
+	builder.BuildPackedVertices(heights, TerrainPatchSet(), packedGrid);
+	double gridMs = ElapsedMs(start);
+	start = BenchClock::now();
+	builder.BuildPackedVertices(heights, chunks, packedChunks);
+	double chunkMs = ElapsedMs(start);
+
+	const double mb = 1024.0 * 1024.0;
+	const double floatBytes = (double)chunkVertices.size() * sizeof(glm::vec3);
+	printf("vformat %dx%d, 65^2 chunks, %.0f vertex fetches/frame (column strips, FIFO 32)\n", size, size, fetches);
+	printf("  vec3 float        12 B: %8.2f MB  build %7.2f ms  fetch %7.2f MB/frame\n",
+		floatBytes / mb, floatMs, fetches * 12 / mb);
+	printf("  packed shorts      8 B: %8.2f MB  build %7.2f ms  fetch %7.2f MB/frame  (%.2fx smaller, whole grid)\n",
+		packedGrid.data.size() / mb, gridMs, fetches * 8 / mb, (double)size * size * 12 / packedGrid.data.size());
+	printf("  packed chunk bytes 4 B: %8.2f MB  build %7.2f ms  fetch %7.2f MB/frame  (%.2fx smaller)\n",
+		packedChunks.data.size() / mb, chunkMs, fetches * 4 / mb, floatBytes / packedChunks.data.size());
+	return 0;
+}
+
+// normals [size]: normal map generation throughput by thread count
+static int BenchNormals(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 4096;
+	if (size < 2) {
+		printf("normals: bad size\n");
+		return 1;
+	}
+	Heightfield heights;
+	MakeMountainHeights(size, heights);
+	const double mpixels = (double)size * size / 1e6;
+#ifdef TERRAIN_SSE2
+	const char* path = "SSE2";
+#else
+	const char* path = "scalar";
+#endif
+
+	int threadCounts[4] = { 1, 2, 4, ResolveThreadCount(0) };
+	std::vector<short> normals;
+	printf("normals %dx%d (%.1f Mpixel, %s), %.1f MB encoded\n", size, size, mpixels, path,
+		(double)size * size * 4 / (1024.0 * 1024.0));
+	for (int i = 0; i < 4; i++) {
+		if (i == 3 && (threadCounts[3] == 1 || threadCounts[3] == 2 || threadCounts[3] == 4))
+			break;
+		BuildNormalMap(heights, 0.1f, 1.0f, normals, threadCounts[i]);  // warm-up, also sizes the output
+
+		const int runs = 3;
+		double best = 1e30;
+		for (int r = 0; r < runs; r++) {
+			BenchClock::time_point start = BenchClock::now();
+			BuildNormalMap(heights, 0.1f, 1.0f, normals, threadCounts[i]);
+			double ms = ElapsedMs(start);
+			best = ms < best ? ms : best;
+		}
+		double rate = mpixels / (best / 1000.0);
+		printf("  threads %2d: %8.2f ms  %8.1f Mpixel/s  %8.1f Mpixel/s per thread\n",
+			threadCounts[i], best, rate, rate / threadCounts[i]);
+	}
+	return 0;
+}
+
+// tiles [size] [tileSize]: writes a .thf file, then random single-tile reads at every level
+// and the assembled level 0 against the source
+static int BenchTiles(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 4097;
+	int tileSize = argc > 1 ? atoi(argv[1]) : 256;
+	if (size < 2) {
+		printf("tiles: bad size\n");
+		return 1;
+	}
+	const char* path = "bench_tiles.thf";
+	Heightfield heights;
+	MakeMountainHeights(size, heights);
+	const double rawMb = heights.ByteSize() / (1024.0 * 1024.0);
+
+	BenchClock::time_point start = BenchClock::now();
+	if (!WriteTiledHeightfield(heights, path, tileSize, 0, TILE_COMPRESSION::PLANE_VARINT))
+		return 1;
+	double writeMs = ElapsedMs(start);
+	TiledHeightfield tiles;
+	if (!tiles.Open(path))
+		return 1;
+	size_t tileCount = 0, stored = 0;
+	for (int l = 0; l < tiles.GetLevelCount(); l++) {
+		tileCount += (size_t)tiles.GetTilesX(l) * tiles.GetTilesZ(l);
+		for (int tr = 0; tr < tiles.GetTilesZ(l); tr++)
+			for (int tc = 0; tc < tiles.GetTilesX(l); tc++)
+				stored += tiles.GetEntry(l, tr, tc).size;
+	}
+	printf("tiles %dx%d (%.1f MB), %d^2 tiles, %d levels, %zu tiles\n", size, size, rawMb, tileSize, tiles.GetLevelCount(), tileCount);
+	printf("  write:  %8.2f ms  %.1f MB on disk (%.2f of raw tiles)\n", writeMs, stored / (1024.0 * 1024.0),
+		(double)stored / (tileCount * (double)(tileSize + 1) * (tileSize + 1) * 2));
+
+	// random tiles at random levels, the file is in the OS cache after writing it
+	const int reads = 2000;
+	Heightfield tile;
+	unsigned int seed = 1;
+	size_t bytes = 0;
+	start = BenchClock::now();
+	for (int i = 0; i < reads; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		int level = (seed >> 8) % tiles.GetLevelCount();
+		int tr = (seed >> 12) % tiles.GetTilesZ(level);
+		int tc = (seed >> 20) % tiles.GetTilesX(level);
+		if (!tiles.ReadTile(level, tr, tc, tile)) {
+			printf("tiles: read failed\n");
+			return 1;
+		}
+		bytes += tiles.GetEntry(level, tr, tc).size;
+	}
+	double readMs = ElapsedMs(start);
+	printf("  read:   %8.3f ms/tile  %8.1f MB/s decoded\n", readMs / reads,
+		reads * (double)(tileSize + 1) * (tileSize + 1) * 2 / (1024.0 * 1024.0) / (readMs / 1000.0));
+
+	Heightfield level0;
+	start = BenchClock::now();
+	bool ok = LoadHeightfieldTiled(path, 0, level0);
+	double loadMs = ElapsedMs(start);
+	ok = ok && level0.width == heights.width && level0.height == heights.height && level0.r16 == heights.r16;
+	printf("  level 0: %7.2f ms  %s\n", loadMs, ok ? "matches source" : "MISMATCH");
+	tiles.Close();
+	remove(path);
+	return ok ? 0 : 1;
+}
+
+// stream [size] [frames]: TileStreamer flying over a .thf file at 60 frames per second;
+// the render thread must never wait for a tile read
+static int BenchStream(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 8193;
+	int frames = argc > 1 ? atoi(argv[1]) : 600;
+	if (size < 2 || frames < 1) {
+		printf("stream: bad arguments\n");
+		return 1;
+	}
+	const char* path = "bench_stream.thf";
+	const int tileSize = 128;
+	{
+		Heightfield heights;
+		MakeMountainHeights(size, heights);
+		if (!WriteTiledHeightfield(heights, path, tileSize, 0, TILE_COMPRESSION::PLANE_VARINT))
+			return 1;
+	}
+
+	// one synchronous level 0 read, for comparison with Update
+	TiledHeightfield tiles;
+	if (!tiles.Open(path))
+		return 1;
+	Heightfield tile;
+	const int reads = 200;
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < reads; i++)
+		tiles.ReadTile(0, i % tiles.GetTilesZ(0), (i * 7) % tiles.GetTilesX(0), tile);
+	double readMs = ElapsedMs(start) / reads;
+	tiles.Close();
+
+	TileStreamer streamer;
+	if (!streamer.Init(path, 1.0f, 100.0f, 2, 32 << 20, 256 << 10, false))
+		return 1;
+	double total = 0.0, worst = 0.0;
+	size_t worstInFlight = 0, drawn = 0;
+	glm::vec3 camera(size * 0.25f, 150.0f, size * 0.25f);
+	BenchClock::time_point frameStart = BenchClock::now();
+	for (int f = 0; f < frames; f++) {
+		float heading = f * 0.005f;
+		camera += glm::vec3(cosf(heading), 0.0f, sinf(heading)) * 8.0f;
+		streamer.Update(camera);
+		const TileStreamer::Stats& stats = streamer.GetStats();
+		total += stats.updateMs;
+		worst = stats.updateMs > worst ? stats.updateMs : worst;
+		worstInFlight = stats.bytesInFlight > worstInFlight ? stats.bytesInFlight : worstInFlight;
+		drawn += streamer.GetDrawnTiles();
+		frameStart += std::chrono::microseconds(16667);
+		std::this_thread::sleep_until(frameStart);
+	}
+	const TileStreamer::Stats& stats = streamer.GetStats();
+	printf("stream %dx%d, %d^2 tiles, %d frames at 60 Hz, 2 workers, %zu slots\n", size, size, tileSize, frames, stats.slots);
+	printf("  update: avg %.3f ms  max %.3f ms  (one tile read %.3f ms)\n", total / frames, worst, readMs);
+	printf("  tiles: %.1f drawn/frame, %zu loaded, %zu resident, hit rate %.1f%%\n",
+		(double)drawn / frames, stats.tilesLoaded, stats.resident, stats.HitRate() * 100.0f);
+	printf("  in flight: max %.1f KB\n", worstInFlight / 1024.0);
+	streamer.Shutdown();
+	remove(path);
+	return 0;
+}
+
+// multidraw [chunks...]: CPU time to submit 9x9-vertex chunks one draw call each, with one
+// glMultiDrawElementsBaseVertex and with one glMultiDrawElementsIndirect. The only benchmark
+// that needs a GL context, it opens a hidden window; GPU time is excluded with glFinish.
+static int BenchMultiDraw(int argc, char** argv)
+{
+	std::vector<int> chunkCounts;
+	for (int i = 0; i < argc; i++)
+		chunkCounts.push_back(atoi(argv[i]));
+	if (chunkCounts.empty()) {
+		chunkCounts.push_back(1000);
+		chunkCounts.push_back(10000);
+		chunkCounts.push_back(100000);
+	}
+	if (!glfwInit()) {
+		printf("multidraw: no GLFW\n");
+		return 1;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	GLFWwindow* window = glfwCreateWindow(256, 256, "multidraw", NULL, NULL);
+	if (window == NULL) {
+		printf("multidraw: no GL context\n");
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	if (glewInit() != GLEW_OK) {
+		glfwTerminate();
+		return 1;
+	}
+	GLuint vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	glBindVertexArray(vertexArray);
+	GLuint program = LoadShaders("shader\\heightmap_vertexshader.glsl", "shader\\fragmentshader.glsl");
+	const GLint gridColsID = glGetUniformLocation(program, "gridCols");
+	const GLint gridOriginID = glGetUniformLocation(program, "gridOrigin");
+	const GLint vertexBaseID = glGetUniformLocation(program, "vertexBase");
+	const GLint chunkStrideID = glGetUniformLocation(program, "chunkStride");
+	glUseProgram(program);
+	glm::mat4 mvp = glm::ortho(0.0f, 1.0f, 0.0f, 1.0f, -1.0f, 1.0f);
+	glUniformMatrix4fv(glGetUniformLocation(program, "MVP"), 1, GL_FALSE, &mvp[0][0]);
+	glUniform1i(glGetUniformLocation(program, "heightTexture"), 0);
+	glUniform1i(glGetUniformLocation(program, "chunkTable"), 2);
+	glUniform1f(glGetUniformLocation(program, "spacing"), 1.0f);
+	glUniform1f(glGetUniformLocation(program, "heightScale"), 0.0f);
+	const bool indirect = ChunkBatcher::IndirectSupported();
+
+	printf("multidraw: CPU submit time per frame, 9x9-vertex chunks (%s)\n", (const char*)glGetString(GL_RENDERER));
+	const int chunkVerts = 9, frames = 20;
+	for (size_t n = 0; n < chunkCounts.size(); n++) {
+		const int side = (int)ceil(sqrt((double)chunkCounts[n]));
+		const int size = side * (chunkVerts - 1) + 1;
+		Heightfield heights;
+		MakeSyntheticHeights(size, heights);
+		GLuint heightTexture = UploadHeightfieldTexture(heights);
+		TerrainPatchSet patches;
+		BuildGridPatches(size, size, chunkVerts, patches, GRID_ORDER::COLUMN_STRIPS);
+		std::vector<unsigned int> visible(chunkCounts[n]);
+		for (size_t v = 0; v < visible.size(); v++)
+			visible[v] = (unsigned int)v;
+		GLuint elementBuffer;
+		glGenBuffers(1, &elementBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, patches.indices.size() * sizeof(GLushort), &patches.indices[0], GL_STATIC_DRAW);
+		ChunkBatcher batcher;
+		batcher.Init(patches);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_BUFFER, batcher.GetChunkTexture());
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, heightTexture);
+
+		double ms[3] = { 0.0, 0.0, 0.0 };
+		for (int mode = 0; mode < (indirect ? 3 : 2); mode++) {
+			for (int f = -2; f < frames; f++) {   // two warm-up frames
+				BenchClock::time_point start = BenchClock::now();
+				if (mode == 0) {
+					for (size_t v = 0; v < visible.size(); v++) {
+						const TerrainPatch& patch = patches.patches[visible[v]];
+						glUniform1i(gridColsID, patch.cols);
+						glUniform2i(gridOriginID, patch.col, patch.row);
+						glUniform1i(vertexBaseID, patch.baseVertex);
+						glDrawElementsBaseVertex(GL_TRIANGLES, patch.indexCount, GL_UNSIGNED_SHORT,
+							(void*)(patch.firstIndex * sizeof(GLushort)), patch.baseVertex);
+					}
+				}
+				else {
+					glUniform1i(chunkStrideID, batcher.GetChunkStride());
+					batcher.Build(patches, visible, true);
+					batcher.Submit(mode == 1 ? CHUNK_SUBMIT::MULTI_DRAW : CHUNK_SUBMIT::INDIRECT, GL_TRIANGLES);
+					glUniform1i(chunkStrideID, 0);
+				}
+				if (f >= 0)
+					ms[mode] += ElapsedMs(start);
+				glFinish();
+			}
+		}
+		printf("  %7d chunks: per chunk %8.3f ms  multi-draw %8.3f ms  indirect ", chunkCounts[n], ms[0] / frames, ms[1] / frames);
+		if (indirect)
+			printf("%8.3f ms\n", ms[2] / frames);
+		else
+			printf("unsupported\n");
+		batcher.Shutdown();
+		glDeleteBuffers(1, &elementBuffer);
+		glDeleteTextures(1, &heightTexture);
+	}
+	glDeleteProgram(program);
+	glDeleteVertexArrays(1, &vertexArray);
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
+
+// trace [events]: cost of a TRACE_SCOPE with recording off and on (4 threads recording at once),
+// and a mesh build with recording off against on
+static int BenchTrace(int argc, char** argv)
+{
+	int events = argc > 0 ? atoi(argv[0]) : 50000;
+	if (events < 1 || events > 60000) {
+		printf("trace: events must be 1..60000 (per thread buffer)\n");
+		return 1;
+	}
+#ifdef TERRAIN_NO_TRACE
+	printf("trace: built with TERRAIN_NO_TRACE, scopes compile to nothing\n");
+#endif
+	volatile int sink = 0;
+	const int offScopes = events * 100;
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < offScopes; i++)
+		sink = sink + 1;
+	double baseMs = ElapsedMs(start);
+	start = BenchClock::now();
+	for (int i = 0; i < offScopes; i++) {
+		TRACE_SCOPE("bench off");
+		sink = sink + 1;
+	}
+	double offMs = ElapsedMs(start);
+	printf("trace, %d scopes off, %d x 4 threads on\n", offScopes, events);
+	printf("  off: %8.2f ns/iteration (%.2f without the scope)\n", offMs * 1e6 / offScopes, baseMs * 1e6 / offScopes);
+
+	TraceStart();
+	const int threads = 4;
+	start = BenchClock::now();
+	ParallelFor(0, threads, threads, [&](int, int) {
+		TRACE_THREAD_NAME("bench");
+		for (int i = 0; i < events; i++) {
+			TRACE_SCOPE("bench on");
+			sink = sink + 1;
+		}
+	});
+	double onMs = ElapsedMs(start);
+	TraceStop();
+	printf("  on:  %8.2f ns/scope (%zu dropped)\n", onMs * 1e6 / ((double)events * threads), TraceGetDroppedEvents());
+	// Every TraceStart below begins a new capture, write this one first
+	if (!TraceWrite("bench_trace.json"))
+		return 1;
+
+	Heightfield heights;
+	MakeSyntheticHeights(2048, heights);
+	std::vector<glm::vec3> vertices;
+	TerrainIndexBuffer indices;
+	TerrainMeshBuilder builder(1);
+	builder.Build(heights, vertices, indices);
+	double best[2] = { 1e30, 1e30 };
+	for (int r = 0; r < 20; r++) {
+		const int on = r & 1;
+		if (on)
+			TraceStart();
+		start = BenchClock::now();
+		builder.Build(heights, vertices, indices);
+		double ms = ElapsedMs(start);
+		TraceStop();
+		best[on] = ms < best[on] ? ms : best[on];
+	}
+	printf("  mesh 2048^2: off %.2f ms, on %.2f ms (%+.2f%%)\n", best[0], best[1], (best[1] / best[0] - 1.0) * 100.0);
+	return 0;
+}
+
+// Checks the triangles of a grid index list: every index inside the width x height grid (or the
+// restart index between strips), every triangle non-degenerate and spanning one grid quad.
+// Adds the triangle count to triangles and returns false at the first bad index.
+template<typename T>
+static bool CheckGridTriangles(const T* indices, size_t count, int width, int height, GLenum mode, size_t& triangles)
+{
+	const size_t vertexCount = (size_t)width * height;
+	const T restart = (T)~(T)0;
+	size_t stripLength = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (mode == GL_TRIANGLE_STRIP && indices[i] == restart) {
+			stripLength = 0;
+			continue;
+		}
+		if ((size_t)indices[i] >= vertexCount) {
+			printf("  index %zu: %zu outside %zu vertices\n", i, (size_t)indices[i], vertexCount);
+			return false;
+		}
+		T tri[3];
+		if (mode == GL_TRIANGLE_STRIP) {
+			if (++stripLength < 3)
+				continue;
+			tri[0] = indices[i - 2]; tri[1] = indices[i - 1]; tri[2] = indices[i];
+		}
+		else {
+			if (i % 3 != 2)
+				continue;
+			tri[0] = indices[i - 2]; tri[1] = indices[i - 1]; tri[2] = indices[i];
+		}
+		int rowMin = height, rowMax = -1, colMin = width, colMax = -1;
+		for (int k = 0; k < 3; k++) {
+			const int row = (int)(tri[k] / width), col = (int)(tri[k] % width);
+			rowMin = row < rowMin ? row : rowMin;
+			rowMax = row > rowMax ? row : rowMax;
+			colMin = col < colMin ? col : colMin;
+			colMax = col > colMax ? col : colMax;
+		}
+		if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2] || rowMax - rowMin != 1 || colMax - colMin != 1) {
+			printf("  triangle ending at index %zu (%zu, %zu, %zu) is not a grid triangle\n", i,
+				(size_t)tri[0], (size_t)tri[1], (size_t)tri[2]);
+			return false;
+		}
+		triangles++;
+	}
+	return true;
+}
+
+// indices [size]: checks BuildGridIndices (16/32-bit choice) and BuildGridPatches for every order and
+// primitive: all indices in range, all triangles in place, 2 per quad. Returns 1 on the first failure.
+static int BenchIndices(int argc, char** argv)
+{
+	int size = argc > 0 ? atoi(argv[0]) : 1024;
+	if (size < 2) {
+		printf("indices: bad size\n");
+		return 1;
+	}
+	// Around the 16-bit limit (65536 vertices for lists, 65535 for strips) and the requested size
+	const int sizes[4] = { 255, 256, 257, size };
+	const GRID_ORDER orders[2] = { GRID_ORDER::ROWS, GRID_ORDER::COLUMN_STRIPS };
+	const GRID_PRIMITIVE primitives[2] = { GRID_PRIMITIVE::TRIANGLES, GRID_PRIMITIVE::STRIPS };
+	const char* names[2][2] = { { "rows, triangles", "rows, strips" }, { "column strips, triangles", "column strips, strips" } };
+	const int patchSizes[2] = { 65, 256 };
+	for (int s = 0; s < 4; s++) {
+		const int n = sizes[s];
+		const size_t vertexCount = (size_t)n * n;
+		const size_t expected = (size_t)(n - 1) * (n - 1) * 2;
+		printf("indices %dx%d (%zu vertices, %zu triangles)\n", n, n, vertexCount, expected);
+		for (int o = 0; o < 2; o++) {
+			for (int p = 0; p < 2; p++) {
+				TerrainIndexBuffer grid;
+				BuildGridIndices(n, n, grid, 0, orders[o], primitives[p]);
+				const size_t max16 = primitives[p] == GRID_PRIMITIVE::STRIPS ? MAX_16BIT_STRIP_VERTICES : MAX_16BIT_VERTICES;
+				const GLenum type = vertexCount <= max16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+				size_t triangles = 0;
+				bool ok = grid.type == type;
+				if (!ok)
+					printf("  %s: %d-bit indices for %zu vertices\n", names[o][p], type == GL_UNSIGNED_SHORT ? 32 : 16, vertexCount);
+				ok = ok && (grid.type == GL_UNSIGNED_SHORT ?
+					CheckGridTriangles(grid.indices16.data(), grid.indices16.size(), n, n, grid.mode, triangles) :
+					CheckGridTriangles(grid.indices32.data(), grid.indices32.size(), n, n, grid.mode, triangles));
+				ok = ok && triangles == expected;
+				printf("  %-26s grid %s-bit %s", names[o][p], grid.type == GL_UNSIGNED_SHORT ? "16" : "32", ok ? "ok" : "FAILED");
+				if (!ok)
+					printf(" (%zu triangles)", triangles);
+				for (int c = 0; c < 2 && ok; c++) {
+					TerrainPatchSet chunks;
+					BuildGridPatches(n, n, patchSizes[c], chunks, orders[o], primitives[p]);
+					size_t patchTriangles = 0, patchVertices = 0;
+					for (size_t i = 0; i < chunks.patches.size() && ok; i++) {
+						const TerrainPatch& patch = chunks.patches[i];
+						ok = (size_t)patch.baseVertex == patchVertices &&
+							CheckGridTriangles(&chunks.indices[patch.firstIndex], (size_t)patch.indexCount, patch.cols, patch.rows,
+								chunks.mode, patchTriangles);
+						patchVertices += (size_t)patch.rows * patch.cols;
+					}
+					ok = ok && patchVertices == chunks.vertexCount && patchTriangles == expected;
+					printf(", %d^2 patches %s", patchSizes[c], ok ? "ok" : "FAILED");
+					if (!ok)
+						printf(" (%zu triangles)", patchTriangles);
+				}
+				printf("\n");
+				if (!ok)
+					return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int RunBenchmark(const char* name, int argc, char** argv)
+{
+	if (strcmp(name, "mesh") == 0)
+		return BenchMesh(argc, argv);
+	if (strcmp(name, "bmp") == 0)
+		return BenchBmp(argc, argv);
+	if (strcmp(name, "cdlod") == 0)
+		return BenchCdlod(argc, argv);
+	if (strcmp(name, "clipmap") == 0)
+		return BenchClipmap(argc, argv);
+	if (strcmp(name, "cull") == 0)
+		return BenchCull(argc, argv);
+	if (strcmp(name, "horizon") == 0)
+		return BenchHorizon(argc, argv);
+	if (strcmp(name, "occlusion") == 0)
+		return BenchOcclusion(argc, argv);
+	if (strcmp(name, "indices") == 0)
+		return BenchIndices(argc, argv);
+	if (strcmp(name, "vcache") == 0)
+		return BenchVertexCache(argc, argv);
+	if (strcmp(name, "vformat") == 0)
+		return BenchVertexFormat(argc, argv);
+	if (strcmp(name, "normals") == 0)
+		return BenchNormals(argc, argv);
+	if (strcmp(name, "tiles") == 0)
+		return BenchTiles(argc, argv);
+	if (strcmp(name, "stream") == 0)
+		return BenchStream(argc, argv);
+	if (strcmp(name, "multidraw") == 0)
+		return BenchMultiDraw(argc, argv);
+	if (strcmp(name, "trace") == 0)
+		return BenchTrace(argc, argv);
+
+	printf("Unknown benchmark: %s\n", name);
+	printf("Available: mesh [size], bmp [file], cdlod [frames], clipmap [frames] [speed], cull [chunks], horizon [size],\n           occlusion [size] [threads], indices [size], vcache [size], vformat [size], normals [size],\n           tiles [size] [tileSize], stream [size] [frames], multidraw [chunks...],\n           trace [events]\n");
+	return 1;
+}
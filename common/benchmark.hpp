@@ -0,0 +1,9 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+// Command line micro-benchmarks, run without opening a window:
+//   3D_Terrain --bench <name> [args...]
+// Returns the process exit code (non-zero for an unknown benchmark or bad arguments).
+int RunBenchmark(const char* name, int argc, char** argv);
+
+#endif
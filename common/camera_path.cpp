@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "camera_path.hpp"
+
+const float CameraPath::DEFAULT_TIMESTEP = 1.0f / 60.0f;
+
+CameraPath::CameraPath()
+	: timestep(DEFAULT_TIMESTEP)
+{
+}
+
+int CameraPath::GetFrameCount() const
+{
+	if (keys.empty())
+		return 0;
+	return (int)floorf(GetDuration() / timestep + 0.5f) + 1;
+}
+
+CameraKey CameraPath::Sample(float time) const
+{
+	if (time <= keys.front().time)
+		return keys.front();
+	if (time >= keys.back().time)
+		return keys.back();
+	// First key after time
+	size_t lo = 0, hi = keys.size() - 1;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (keys[mid].time <= time)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	const CameraKey& a = keys[lo];
+	const CameraKey& b = keys[hi];
+	const float span = b.time - a.time;
+	const float t = span > 0.0f ? (time - a.time) / span : 0.0f;
+	CameraKey key;
+	key.time = time;
+	key.position = glm::mix(a.position, b.position, t);
+	key.horizontalAngle = a.horizontalAngle + (b.horizontalAngle - a.horizontalAngle) * t;
+	key.verticalAngle = a.verticalAngle + (b.verticalAngle - a.verticalAngle) * t;
+	key.fov = a.fov + (b.fov - a.fov) * t;
+	// Neighbouring frames rotate the model by a degree or so, a componentwise blend stays rigid enough
+	key.model = a.model * (1.0f - t) + b.model * t;
+	return key;
+}
+
+CameraKey CameraPath::SampleFrame(int frame) const
+{
+	return Sample((frame % GetFrameCount()) * timestep + keys.front().time);
+}
+
+bool CameraPath::Save(const char* path) const
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("%s could not be opened for writing.\n", path);
+		return false;
+	}
+	CameraPathHeader header;
+	memcpy(header.magic, TCAM_MAGIC, 4);
+	header.version = TCAM_VERSION;
+	header.count = (uint32_t)keys.size();
+	header.timestep = timestep;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	const float start = keys.empty() ? 0.0f : keys.front().time;
+	for (size_t i = 0; i < keys.size() && ok; i++) {
+		const CameraKey& key = keys[i];
+		CameraPathRecord record;
+		record.time = key.time - start;
+		record.position[0] = key.position.x;
+		record.position[1] = key.position.y;
+		record.position[2] = key.position.z;
+		record.horizontalAngle = key.horizontalAngle;
+		record.verticalAngle = key.verticalAngle;
+		record.fov = key.fov;
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 3; r++)
+				record.model[c * 3 + r] = key.model[c][r];
+		}
+		ok = fwrite(&record, sizeof(record), 1, file) == 1;
+	}
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		printf("%s: write failed\n", path);
+	return ok;
+}
+
+bool CameraPath::Load(const char* path)
+{
+	keys.clear();
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		printf("%s could not be opened.\n", path);
+		return false;
+	}
+	CameraPathHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TCAM_MAGIC, 4) != 0 || header.version != TCAM_VERSION) {
+		printf("%s: not a camera path\n", path);
+		fclose(file);
+		return false;
+	}
+	if (header.count == 0 || !(header.timestep > 0.0f)) {
+		printf("%s: empty camera path\n", path);
+		fclose(file);
+		return false;
+	}
+	keys.reserve(header.count);
+	float last = 0.0f;
+	for (uint32_t i = 0; i < header.count; i++) {
+		CameraPathRecord record;
+		if (fread(&record, sizeof(record), 1, file) != 1 || record.time < last) {
+			printf("%s: truncated or unordered at record %u\n", path, i);
+			keys.clear();
+			fclose(file);
+			return false;
+		}
+		last = record.time;
+		CameraKey key;
+		key.time = record.time;
+		key.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+		key.horizontalAngle = record.horizontalAngle;
+		key.verticalAngle = record.verticalAngle;
+		key.fov = record.fov;
+		key.model = glm::mat4(1.0f);
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 3; r++)
+				key.model[c][r] = record.model[c * 3 + r];
+		}
+		keys.push_back(key);
+	}
+	fclose(file);
+	timestep = header.timestep;
+	return true;
+}
+
+CameraPath CameraPath::Flyover(const glm::vec3& center, float radius, float height, float pitch, float fov, int frames)
+{
+	CameraPath path;
+	const float pi = 3.14159265f;
+	for (int f = 0; f < frames; f++) {
+		const float angle = 2.0f * pi * f / frames;
+		CameraKey key;
+		key.time = f * DEFAULT_TIMESTEP;
+		key.position = glm::vec3(center.x + radius * cosf(angle), center.y + height, center.z + radius * sinf(angle));
+		// Tangent (-sin, cos) as (sin(h), cos(h))
+		key.horizontalAngle = atan2f(-sinf(angle), cosf(angle));
+		key.verticalAngle = -pitch;
+		key.fov = fov;
+		key.model = glm::mat4(1.0f);
+		path.Add(key);
+	}
+	return path;
+}
@@ -0,0 +1,85 @@
+#ifndef CAMERA_PATH_HPP
+#define CAMERA_PATH_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+    Camera path file (.tcam), little-endian:
+
+    CameraPathHeader
+    CameraPathRecord[header.count], in time order
+*/
+
+static const char TCAM_MAGIC[4] = { 'T', 'C', 'A', 'M' };
+static const uint32_t TCAM_VERSION = 1;
+
+struct CameraPathHeader {
+	char magic[4];          // TCAM_MAGIC
+	uint32_t version;       // TCAM_VERSION
+	uint32_t count;         // records
+	float timestep;         // seconds per frame the path is replayed at
+};
+
+struct CameraPathRecord {
+	float time;             // seconds since the first record
+	float position[3];
+	float horizontalAngle;
+	float verticalAngle;
+	float fov;
+	float model[12];        // upper 3 rows of the model matrix, column-major; the last row is (0, 0, 0, 1)
+};
+
+// One camera pose, in the same terms as the interactive camera:
+// direction = (cos(v) sin(h), sin(v), cos(v) cos(h)), fov in degrees
+struct CameraKey {
+	float time;
+	glm::vec3 position;
+	float horizontalAngle;
+	float verticalAngle;
+	float fov;
+	glm::mat4 model;
+};
+
+// Timed camera poses. Recorded at whatever rate the interactive loop ran, replayed by sampling
+// at a fixed timestep, so runs of different render modes see the same views on the same frames.
+class CameraPath {
+public:
+	static const float DEFAULT_TIMESTEP;   // 1/60 s
+
+	CameraPath();
+
+	void Clear() { keys.clear(); }
+	// Keys must come in time order
+	void Add(const CameraKey& key) { keys.push_back(key); }
+
+	size_t Size() const { return keys.size(); }
+	bool Empty() const { return keys.empty(); }
+	const CameraKey& At(size_t i) const { return keys[i]; }
+	float GetDuration() const { return keys.empty() ? 0.0f : keys.back().time; }
+
+	void SetTimestep(float seconds) { timestep = seconds; }
+	float GetTimestep() const { return timestep; }
+	// Frames a replay at GetTimestep() takes to reach the last key
+	int GetFrameCount() const;
+
+	// Pose at time, linear between the neighbouring keys, clamped to the ends
+	CameraKey Sample(float time) const;
+	// Pose of replay frame frame; a run longer than the path loops
+	CameraKey SampleFrame(int frame) const;
+
+	bool Save(const char* path) const;
+	bool Load(const char* path);
+
+	// frames poses DEFAULT_TIMESTEP apart on a circle of radius around center at height above it,
+	// looking along the direction of flight and pitch radians down
+	static CameraPath Flyover(const glm::vec3& center, float radius, float height, float pitch, float fov, int frames);
+
+private:
+	std::vector<CameraKey> keys;
+	float timestep;
+};
+
+#endif
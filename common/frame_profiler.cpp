@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "frame_profiler.hpp"
+#include "trace.hpp"
+
+FrameProfiler::FrameProfiler()
+	: scopeNames(NULL), scopeCount(0), gpuTimer(false), gpuToTrace(0), frame(0),
+	historyFrames(0), historyCount(0), historyNext(0), droppedFrames(0)
+{
+	for (int s = 0; s < LATENCY; s++) {
+		slots[s].pending = false;
+		memset(slots[s].queries, 0, sizeof(slots[s].queries));
+	}
+}
+
+FrameProfiler::~FrameProfiler()
+{
+	Shutdown();
+}
+
+bool FrameProfiler::Init(const char* const* scopeNames, int scopeCount, int historyFrames)
+{
+	Shutdown();
+	if (scopeCount < 1 || scopeCount > MAX_SCOPES || historyFrames < 2) {
+		printf("FrameProfiler: bad size %d scopes x %d frames\n", scopeCount, historyFrames);
+		return false;
+	}
+	this->scopeNames = scopeNames;
+	this->scopeCount = scopeCount;
+	this->historyFrames = historyFrames;
+	cpuHistory.assign((size_t)scopeCount * historyFrames, 0.0f);
+	gpuHistory.assign((size_t)scopeCount * historyFrames, 0.0f);
+	historyFrame.assign(historyFrames, 0);
+	historyCount = 0;
+	historyNext = 0;
+	droppedFrames = 0;
+	frame = 0;
+
+	GLint bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	gpuTimer = bits > 0;
+	if (gpuTimer) {
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		gpuToTrace = TraceNow() - gpuNow;
+	}
+	for (int s = 0; s < LATENCY; s++) {
+		slots[s].pending = false;
+		if (gpuTimer)
+			glGenQueries(MAX_SCOPES * 2, &slots[s].queries[0][0]);
+	}
+	return true;
+}
+
+void FrameProfiler::Shutdown()
+{
+	for (int s = 0; s < LATENCY; s++) {
+		if (gpuTimer)
+			glDeleteQueries(MAX_SCOPES * 2, &slots[s].queries[0][0]);
+		slots[s].pending = false;
+		memset(slots[s].queries, 0, sizeof(slots[s].queries));
+	}
+	gpuTimer = false;
+	scopeCount = 0;
+}
+
+void FrameProfiler::BeginFrame()
+{
+	if (scopeCount == 0)
+		return;
+	Slot& slot = slots[frame % LATENCY];
+	if (slot.pending)
+		Resolve(slot);
+	slot.frame = frame;
+	slot.pending = true;
+	for (int s = 0; s < scopeCount; s++) {
+		slot.used[s] = false;
+		slot.cpuMs[s] = 0.0f;
+	}
+}
+
+void FrameProfiler::Begin(int scope)
+{
+	if (scopeCount == 0)
+		return;
+	Slot& slot = slots[frame % LATENCY];
+	slot.used[scope] = true;
+	if (gpuTimer)
+		glQueryCounter(slot.queries[scope][0], GL_TIMESTAMP);
+	slot.cpuStart[scope] = TraceNow();
+}
+
+void FrameProfiler::End(int scope)
+{
+	if (scopeCount == 0)
+		return;
+	Slot& slot = slots[frame % LATENCY];
+	const int64_t now = TraceNow();
+	slot.cpuMs[scope] = (now - slot.cpuStart[scope]) / 1000000.0f;
+#ifndef TERRAIN_NO_TRACE
+	if (TraceIsEnabled())
+		TraceComplete(scopeNames[scope], slot.cpuStart[scope], now);
+#endif
+	if (gpuTimer)
+		glQueryCounter(slot.queries[scope][1], GL_TIMESTAMP);
+}
+
+void FrameProfiler::EndFrame()
+{
+	frame++;
+}
+
+void FrameProfiler::Resolve(Slot& slot)
+{
+	slot.pending = false;
+	float gpuMs[MAX_SCOPES] = {};
+	if (gpuTimer) {
+		// Timestamps complete in order, so checking the last one of every scope is enough
+		for (int s = 0; s < scopeCount; s++) {
+			if (!slot.used[s])
+				continue;
+			GLint available = 0;
+			glGetQueryObjectiv(slot.queries[s][1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				droppedFrames++;
+				return;
+			}
+		}
+		for (int s = 0; s < scopeCount; s++) {
+			if (!slot.used[s])
+				continue;
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(slot.queries[s][0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(slot.queries[s][1], GL_QUERY_RESULT, &end);
+			gpuMs[s] = end > begin ? (end - begin) / 1000000.0f : 0.0f;
+#ifndef TERRAIN_NO_TRACE
+			if (TraceIsEnabled() && end > begin)
+				TraceGpuComplete(scopeNames[s], (int64_t)begin + gpuToTrace, (int64_t)end + gpuToTrace);
+#endif
+		}
+	}
+	for (int s = 0; s < scopeCount; s++) {
+		cpuHistory[(size_t)s * historyFrames + historyNext] = slot.cpuMs[s];
+		gpuHistory[(size_t)s * historyFrames + historyNext] = gpuMs[s];
+	}
+	historyFrame[historyNext] = slot.frame;
+	historyNext = (historyNext + 1) % historyFrames;
+	if (historyCount < historyFrames)
+		historyCount++;
+}
+
+float FrameProfiler::Average(const std::vector<float>& history, int scope) const
+{
+	if (historyCount == 0)
+		return 0.0f;
+	const float* values = &history[(size_t)scope * historyFrames];
+	float sum = 0.0f;
+	for (int i = 0; i < historyCount; i++)
+		sum += values[i];
+	return sum / historyCount;
+}
+
+float FrameProfiler::GetCpuAverage(int scope) const
+{
+	return Average(cpuHistory, scope);
+}
+
+float FrameProfiler::GetGpuAverage(int scope) const
+{
+	return Average(gpuHistory, scope);
+}
+
+bool FrameProfiler::WriteCsv(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("%s could not be opened for writing.\n", path);
+		return false;
+	}
+	fprintf(file, "frame");
+	for (int s = 0; s < scopeCount; s++)
+		fprintf(file, ",%s_cpu_ms,%s_gpu_ms", scopeNames[s], scopeNames[s]);
+	fprintf(file, "\n");
+	const int offset = GetHistoryOffset();
+	for (int i = 0; i < historyCount; i++) {
+		const int h = (offset + i) % historyFrames;
+		fprintf(file, "%u", historyFrame[h]);
+		for (int s = 0; s < scopeCount; s++)
+			fprintf(file, ",%.4f,%.4f", cpuHistory[(size_t)s * historyFrames + h], gpuHistory[(size_t)s * historyFrames + h]);
+		fprintf(file, "\n");
+	}
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	if (!ok)
+		printf("%s: write failed\n", path);
+	return ok;
+}
@@ -0,0 +1,80 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+
+// CPU and GPU time of named passes (scopes) of the render loop, kept for the last historyFrames frames.
+//
+// Begin/End take a steady_clock time and put a GL_TIMESTAMP query into the command stream, so scopes
+// may nest or leave gaps. The queries of a frame are only read LATENCY frames later, when the slot is
+// reused; if the GPU is still behind by then the frame is dropped instead of waited for. A frame enters
+// the history (CPU and GPU times together) when its queries have been read.
+// While tracing (trace.hpp) every scope is also a trace event, and resolved GPU times go to the GPU track.
+class FrameProfiler {
+public:
+	static const int MAX_SCOPES = 8;
+	static const int LATENCY = 4;   // frames of queries in flight
+
+	FrameProfiler();
+	~FrameProfiler();
+
+	// scopeNames must outlive the profiler. GPU timing is off when the driver has no timestamp bits.
+	bool Init(const char* const* scopeNames, int scopeCount, int historyFrames = 256);
+	void Shutdown();
+
+	void BeginFrame();
+	// One Begin/End pair per scope and frame; a scope that is not entered counts as 0 ms
+	void Begin(int scope);
+	void End(int scope);
+	void EndFrame();
+
+	bool HasGpuTimer() const { return gpuTimer; }
+	int GetScopeCount() const { return scopeCount; }
+	const char* GetScopeName(int scope) const { return scopeNames[scope]; }
+
+	// Ring of GetHistorySize() values per scope starting at GetHistoryOffset() (ImGui::PlotLines layout)
+	int GetHistorySize() const { return historyCount; }
+	int GetHistoryOffset() const { return historyCount < historyFrames ? 0 : historyNext; }
+	const float* GetCpuHistory(int scope) const { return &cpuHistory[(size_t)scope * historyFrames]; }
+	const float* GetGpuHistory(int scope) const { return &gpuHistory[(size_t)scope * historyFrames]; }
+	// Means over the history
+	float GetCpuAverage(int scope) const;
+	float GetGpuAverage(int scope) const;
+	size_t GetDroppedFrames() const { return droppedFrames; }
+
+	// frame,<scope>_cpu_ms,<scope>_gpu_ms,... oldest frame first
+	bool WriteCsv(const char* path) const;
+
+private:
+	// Queries and CPU times of one frame in flight
+	struct Slot {
+		unsigned int frame;
+		bool pending;
+		bool used[MAX_SCOPES];
+		float cpuMs[MAX_SCOPES];
+		int64_t cpuStart[MAX_SCOPES];   // TraceNow()
+		GLuint queries[MAX_SCOPES][2];  // begin, end timestamps
+	};
+
+	const char* const* scopeNames;
+	int scopeCount;
+	bool gpuTimer;
+	int64_t gpuToTrace;                 // GL_TIMESTAMP + gpuToTrace = TraceNow()
+	unsigned int frame;
+	Slot slots[LATENCY];
+	int historyFrames;
+	int historyCount;
+	int historyNext;
+	std::vector<float> cpuHistory;      // historyFrames per scope
+	std::vector<float> gpuHistory;
+	std::vector<unsigned int> historyFrame;
+	size_t droppedFrames;
+
+	void Resolve(Slot& slot);
+	float Average(const std::vector<float>& history, int scope) const;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <vector>
+
+#include "frame_report.hpp"
+
+static void WriteJsonString(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const char* c = text ? text : ""; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*c >= 0x20)
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+// "name": {"avg": .., "min": .., "max": ..} over the samples with value >= 0
+static void WriteSummary(FILE* file, const char* name, const std::vector<FrameSample>& samples, float (*value)(const FrameSample&))
+{
+	double sum = 0.0;
+	float lo = 0.0f, hi = 0.0f;
+	size_t count = 0;
+	for (size_t i = 0; i < samples.size(); i++) {
+		float v = value(samples[i]);
+		if (v < 0.0f)
+			continue;
+		lo = count == 0 || v < lo ? v : lo;
+		hi = count == 0 || v > hi ? v : hi;
+		sum += v;
+		count++;
+	}
+	fprintf(file, "    \"%s\": {\"avg\": %.4f, \"min\": %.4f, \"max\": %.4f, \"samples\": %zu}",
+		name, count ? sum / count : 0.0, lo, hi, count);
+}
+
+static float CpuMs(const FrameSample& s) { return s.cpuMs; }
+static float GpuMs(const FrameSample& s) { return s.gpuMs; }
+static float Triangles(const FrameSample& s) { return (float)s.triangles; }
+static float DrawCalls(const FrameSample& s) { return (float)s.drawCalls; }
+
+bool WriteFrameReport(const char* path, const FrameReportInfo& info, const std::vector<FrameSample>& samples)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Impossible to write %s\n", path);
+		return false;
+	}
+	fprintf(file, "{\n  \"mode\": ");
+	WriteJsonString(file, info.mode);
+	fprintf(file, ",\n  \"renderer\": ");
+	WriteJsonString(file, info.renderer);
+	fprintf(file, ",\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %zu,\n", info.width, info.height, samples.size());
+
+	fprintf(file, "  \"summary\": {\n");
+	WriteSummary(file, "cpu_ms", samples, CpuMs);
+	fprintf(file, ",\n");
+	WriteSummary(file, "gpu_ms", samples, GpuMs);
+	fprintf(file, ",\n");
+	WriteSummary(file, "triangles", samples, Triangles);
+	fprintf(file, ",\n");
+	WriteSummary(file, "draw_calls", samples, DrawCalls);
+	fprintf(file, "\n  },\n");
+
+	fprintf(file, "  \"cpu_ms\": [");
+	for (size_t i = 0; i < samples.size(); i++)
+		fprintf(file, "%s%.4f", i ? ", " : "", samples[i].cpuMs);
+	fprintf(file, "],\n  \"gpu_ms\": [");
+	for (size_t i = 0; i < samples.size(); i++) {
+		if (samples[i].gpuMs < 0.0f)
+			fprintf(file, "%snull", i ? ", " : "");
+		else
+			fprintf(file, "%s%.4f", i ? ", " : "", samples[i].gpuMs);
+	}
+	fprintf(file, "],\n  \"triangles\": [");
+	for (size_t i = 0; i < samples.size(); i++)
+		fprintf(file, "%s%zu", i ? ", " : "", samples[i].triangles);
+	fprintf(file, "],\n  \"draw_calls\": [");
+	for (size_t i = 0; i < samples.size(); i++)
+		fprintf(file, "%s%zu", i ? ", " : "", samples[i].drawCalls);
+	fprintf(file, "]\n}\n");
+
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	if (!ok)
+		printf("Error writing %s\n", path);
+	return ok;
+}
@@ -0,0 +1,27 @@
+#ifndef FRAME_REPORT_HPP
+#define FRAME_REPORT_HPP
+
+#include <stddef.h>
+#include <vector>
+
+// Measurements of one rendered frame
+struct FrameSample {
+	float cpuMs;        // wall time of the frame on the render thread
+	float gpuMs;        // GL_TIME_ELAPSED of the frame, negative when unavailable
+	size_t triangles;
+	size_t drawCalls;
+};
+
+// Run description written at the top of the report
+struct FrameReportInfo {
+	const char* mode;
+	const char* renderer;   // GL_RENDERER
+	int width;
+	int height;
+};
+
+// Writes summary statistics (avg/min/max) and the per-frame arrays as JSON.
+// Prints a message and returns false when the file cannot be written.
+bool WriteFrameReport(const char* path, const FrameReportInfo& info, const std::vector<FrameSample>& samples);
+
+#endif
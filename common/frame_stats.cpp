@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "frame_stats.hpp"
+
+static const int SUB_COUNT = 1 << FrameStats::SUB_BITS;
+static const int HALF_COUNT = SUB_COUNT / 2;
+
+const float FrameStats::STUTTER_FACTOR = 2.0f;
+const float FrameStats::SLOW_MS = 1000.0f / 30.0f;
+
+FrameStats::FrameStats()
+{
+	Reset();
+}
+
+void FrameStats::Reset()
+{
+	memset(buckets, 0, sizeof(buckets));
+	count = 0;
+	sumUs = 0.0;
+	minUs = 0;
+	maxUs = 0;
+}
+
+int FrameStats::BucketOf(uint32_t us)
+{
+	if (us < (uint32_t)SUB_COUNT)
+		return (int)us;
+	int msb = SUB_BITS;
+	while (us >> (msb + 1))
+		msb++;
+	const int shift = msb - (SUB_BITS - 1);
+	const int top = (int)(us >> shift);   // HALF_COUNT..SUB_COUNT-1
+	return SUB_COUNT + (shift - 1) * HALF_COUNT + (top - HALF_COUNT);
+}
+
+uint32_t FrameStats::BucketLow(int bucket)
+{
+	if (bucket < SUB_COUNT)
+		return (uint32_t)bucket;
+	const int k = bucket - SUB_COUNT;
+	const int shift = k / HALF_COUNT + 1;
+	return (uint32_t)(k % HALF_COUNT + HALF_COUNT) << shift;
+}
+
+uint32_t FrameStats::BucketHigh(int bucket)
+{
+	if (bucket < SUB_COUNT)
+		return (uint32_t)bucket + 1;
+	const int shift = (bucket - SUB_COUNT) / HALF_COUNT + 1;
+	return BucketLow(bucket) + (1u << shift);
+}
+
+void FrameStats::Record(float ms)
+{
+	const double us = ms > 0.0f ? ms * 1000.0 : 0.0;
+	const uint32_t bucketUs = us < MAX_US - 1 ? (uint32_t)(us + 0.5) : MAX_US - 1;
+	buckets[BucketOf(bucketUs)]++;
+	minUs = count == 0 || bucketUs < minUs ? bucketUs : minUs;
+	maxUs = count == 0 || bucketUs > maxUs ? bucketUs : maxUs;
+	sumUs += us;
+	count++;
+}
+
+float FrameStats::GetPercentileMs(double fraction) const
+{
+	if (count == 0)
+		return 0.0f;
+	size_t rank = (size_t)ceil(fraction * count);
+	rank = rank < 1 ? 1 : rank > count ? count : rank;
+	size_t seen = 0;
+	for (int b = 0; b < BUCKET_COUNT; b++) {
+		seen += buckets[b];
+		if (seen >= rank) {
+			const uint32_t high = BucketHigh(b);
+			return (high < maxUs ? high : maxUs) / 1000.0f;
+		}
+	}
+	return maxUs / 1000.0f;
+}
+
+size_t FrameStats::CountAbove(float ms) const
+{
+	const double us = ms * 1000.0;
+	size_t above = 0;
+	for (int b = BUCKET_COUNT - 1; b >= 0 && BucketLow(b) > us; b--)
+		above += buckets[b];
+	return above;
+}
+
+FrameStats::Summary FrameStats::GetSummary() const
+{
+	Summary summary;
+	summary.frames = count;
+	summary.meanMs = count ? (float)(sumUs / count / 1000.0) : 0.0f;
+	summary.p50Ms = GetPercentileMs(0.50);
+	summary.p95Ms = GetPercentileMs(0.95);
+	summary.p99Ms = GetPercentileMs(0.99);
+	summary.maxMs = maxUs / 1000.0f;
+	summary.stutters = count ? CountAbove(summary.p50Ms * STUTTER_FACTOR) : 0;
+	summary.slowFrames = CountAbove(SLOW_MS);
+	return summary;
+}
+
+bool FrameStats::WriteJson(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("%s could not be opened for writing.\n", path);
+		return false;
+	}
+	const Summary summary = GetSummary();
+	fprintf(file, "{\n  \"frames\": %zu,\n  \"mean_ms\": %.4f,\n  \"min_ms\": %.4f,\n  \"p50_ms\": %.4f,\n"
+		"  \"p95_ms\": %.4f,\n  \"p99_ms\": %.4f,\n  \"max_ms\": %.4f,\n",
+		summary.frames, summary.meanMs, minUs / 1000.0f, summary.p50Ms, summary.p95Ms, summary.p99Ms, summary.maxMs);
+	fprintf(file, "  \"stutter_factor\": %.2f,\n  \"stutters\": %zu,\n  \"slow_ms\": %.4f,\n  \"slow_frames\": %zu,\n",
+		STUTTER_FACTOR, summary.stutters, SLOW_MS, summary.slowFrames);
+	fprintf(file, "  \"buckets\": [");
+	bool first = true;
+	for (int b = 0; b < BUCKET_COUNT; b++) {
+		if (buckets[b] == 0)
+			continue;
+		fprintf(file, "%s\n    {\"lo_us\": %u, \"hi_us\": %u, \"count\": %u}", first ? "" : ",", BucketLow(b), BucketHigh(b), buckets[b]);
+		first = false;
+	}
+	fprintf(file, "\n  ]\n}\n");
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	if (!ok)
+		printf("%s: write failed\n", path);
+	return ok;
+}
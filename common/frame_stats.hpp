@@ -0,0 +1,62 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Frame time distribution in a fixed log-linear (HdrHistogram style) histogram.
+
+    Times are kept in microseconds. Below 2^SUB_BITS every microsecond has its own bucket; above,
+    every power of two is split into 2^(SUB_BITS-1) equal buckets, so a bucket is never wider than
+    1/64 of its value. Times from MAX_US on share the last bucket (min, max and sum stay exact).
+    Record() is one increment and a few compares, the class holds no heap memory, and percentiles
+    are read from the buckets on demand, so summarizing costs the same after 100 or 10^7 frames.
+*/
+class FrameStats {
+public:
+	static const int SUB_BITS = 7;
+	static const uint32_t MAX_US = 1u << 26;     // 67 s
+	static const int BUCKET_COUNT = (1 << SUB_BITS) + (26 - SUB_BITS) * (1 << (SUB_BITS - 1));
+	static const float STUTTER_FACTOR;           // a stutter takes this many times the median
+	static const float SLOW_MS;                  // frames slower than this missed 30 Hz
+
+	struct Summary {
+		size_t frames;
+		float meanMs;
+		float p50Ms;
+		float p95Ms;
+		float p99Ms;
+		float maxMs;
+		size_t stutters;    // frames over STUTTER_FACTOR * p50
+		size_t slowFrames;  // frames over SLOW_MS
+	};
+
+	FrameStats();
+
+	void Record(float ms);
+	void Reset();
+
+	size_t GetCount() const { return count; }
+	// Upper edge of the bucket holding the given fraction (0..1) of the frames, clamped to the exact max
+	float GetPercentileMs(double fraction) const;
+	// Frames in buckets that lie entirely above ms
+	size_t CountAbove(float ms) const;
+	Summary GetSummary() const;
+
+	// Summary and the non-empty buckets ({"lo_us", "hi_us", "count"}) as JSON
+	bool WriteJson(const char* path) const;
+
+private:
+	uint32_t buckets[BUCKET_COUNT];
+	size_t count;
+	double sumUs;
+	uint32_t minUs;
+	uint32_t maxUs;
+
+	static int BucketOf(uint32_t us);
+	static uint32_t BucketLow(int bucket);
+	static uint32_t BucketHigh(int bucket);
+};
+
+#endif
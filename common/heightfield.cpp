@@ -0,0 +1,218 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "BMPlib.h"
+#include "heightfield.hpp"
+#include "terrain_tiles.hpp"
+#include "trace.hpp"
+
+#ifdef _MSC_VER
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+// Bytes converted per fread() when samples can't be read in place
+static const size_t STREAM_CHUNK_BYTES = 1 << 16;
+
+static bool HasExtension(const char* path, const char* ext)
+{
+	size_t len = strlen(path), extLen = strlen(ext);
+	if (len < extLen)
+		return false;
+	const char* p = path + len - extLen;
+	for (size_t i = 0; i < extLen; i++)
+		if (tolower((unsigned char)p[i]) != ext[i])
+			return false;
+	return true;
+}
+
+bool LoadHeightfield(const char* path, Heightfield& out)
+{
+	TRACE_SCOPE("LoadHeightfield");
+	if (HasExtension(path, ".bmp"))
+		return LoadHeightfieldBMP(path, out);
+	if (HasExtension(path, ".pgm"))
+		return LoadHeightfieldPGM(path, out);
+	if (HasExtension(path, ".r16"))
+		return LoadHeightfieldRaw(path, HEIGHT_FORMAT::R16, 0, 0, out);
+	if (HasExtension(path, ".r32"))
+		return LoadHeightfieldRaw(path, HEIGHT_FORMAT::R32F, 0, 0, out);
+	if (HasExtension(path, ".thf"))
+		return LoadHeightfieldTiled(path, 0, out);
+	printf("%s: unknown heightfield format\n", path);
+	return false;
+}
+
+bool LoadHeightfieldBMP(const char* path, Heightfield& out)
+{
+	TRACE_SCOPE("BMP::ReadAsHeightfield");
+	BMPlib::BMP bmp;
+	if (!bmp.ReadAsHeightfield(path)) {
+		printf("%s could not be opened as a BMP heightfield\n", path);
+		return false;
+	}
+	out.width = (int)bmp.GetWidth();
+	out.height = (int)bmp.GetHeight();
+	out.format = HEIGHT_FORMAT::R16;
+	out.r32f.clear();
+	out.r16.resize((size_t)out.width * out.height);
+	const BMPlib::byte* src = bmp.GetPixelBuffer();
+	for (size_t i = 0; i < out.r16.size(); i++)
+		out.r16[i] = (unsigned short)(src[i] * 257);  // 0..255 ==> 0..65535
+	return true;
+}
+
+// Next whitespace separated number of a PNM header, skipping # comments
+static bool ReadPNMNumber(FILE* file, int& value)
+{
+	int c = fgetc(file);
+	while (c != EOF) {
+		if (c == '#') {
+			while (c != EOF && c != '\n') c = fgetc(file);
+		}
+		else if (!isspace(c))
+			break;
+		c = fgetc(file);
+	}
+	if (c == EOF || !isdigit(c))
+		return false;
+	value = 0;
+	while (c != EOF && isdigit(c)) {
+		value = value * 10 + (c - '0');
+		c = fgetc(file);
+	}
+	// exactly one whitespace character follows the last header field
+	return c != EOF;
+}
+
+bool LoadHeightfieldPGM(const char* path, Heightfield& out)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		printf("%s could not be opened.\n", path);
+		return false;
+	}
+	char magic[2];
+	int width, height, maxval;
+	if (fread(magic, 1, 2, file) != 2 || magic[0] != 'P' || magic[1] != '5' ||
+		!ReadPNMNumber(file, width) || !ReadPNMNumber(file, height) || !ReadPNMNumber(file, maxval) ||
+		width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535) {
+		printf("%s is not a binary PGM file\n", path);
+		fclose(file);
+		return false;
+	}
+
+	out.width = width;
+	out.height = height;
+	out.format = HEIGHT_FORMAT::R16;
+	out.r32f.clear();
+	out.r16.resize((size_t)width * height);
+
+	// Samples are streamed in chunks straight into the output; 16 bit PGM is big-endian.
+	// Samples above maxval (malformed files) are clamped, scaling them would overflow 16 bits.
+	const size_t bytesPerSample = maxval > 255 ? 2 : 1;
+	const float scale = 65535.0f / maxval;
+	unsigned char chunk[STREAM_CHUNK_BYTES];
+	const size_t samplesPerChunk = STREAM_CHUNK_BYTES / bytesPerSample;
+	size_t done = 0;
+	while (done < out.r16.size()) {
+		size_t n = out.r16.size() - done;
+		n = n < samplesPerChunk ? n : samplesPerChunk;
+		if (fread(chunk, bytesPerSample, n, file) != n) {
+			printf("%s: unexpected end of file\n", path);
+			fclose(file);
+			return false;
+		}
+		unsigned short* dst = &out.r16[done];
+		if (bytesPerSample == 2) {
+			for (size_t i = 0; i < n; i++) {
+				unsigned int v = (chunk[i * 2] << 8) | chunk[i * 2 + 1];
+				v = v > (unsigned int)maxval ? (unsigned int)maxval : v;
+				dst[i] = maxval == 65535 ? (unsigned short)v : (unsigned short)(v * scale + 0.5f);
+			}
+		}
+		else {
+			for (size_t i = 0; i < n; i++) {
+				unsigned int v = chunk[i] > maxval ? (unsigned int)maxval : chunk[i];
+				dst[i] = (unsigned short)(v * scale + 0.5f);
+			}
+		}
+		done += n;
+	}
+	fclose(file);
+	return true;
+}
+
+bool LoadHeightfieldRaw(const char* path, HEIGHT_FORMAT format, int width, int height, Heightfield& out)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		printf("%s could not be opened.\n", path);
+		return false;
+	}
+	const size_t bytesPerSample = format == HEIGHT_FORMAT::R16 ? 2 : 4;
+	if (width <= 0 || height <= 0) {
+		fseek64(file, 0, SEEK_END);
+		long long fileSize = (long long)ftell64(file);
+		fseek64(file, 0, SEEK_SET);
+		int side = (int)(sqrt((double)(fileSize / bytesPerSample)) + 0.5);
+		if (fileSize <= 0 || (long long)side * side * (long long)bytesPerSample != fileSize) {
+			printf("%s: raw heightfield is not square, give its size explicitly\n", path);
+			fclose(file);
+			return false;
+		}
+		width = height = side;
+	}
+
+	out.width = width;
+	out.height = height;
+	out.format = format;
+	const size_t count = (size_t)width * height;
+	// Little-endian samples can be read in place, no intermediate buffer
+	size_t read;
+	if (format == HEIGHT_FORMAT::R16) {
+		out.r32f.clear();
+		out.r16.resize(count);
+		read = fread(&out.r16[0], bytesPerSample, count, file);
+	}
+	else {
+		out.r16.clear();
+		out.r32f.resize(count);
+		read = fread(&out.r32f[0], bytesPerSample, count, file);
+	}
+	fclose(file);
+	if (read != count) {
+		printf("%s: unexpected end of file\n", path);
+		return false;
+	}
+	return true;
+}
+
+GLuint UploadHeightfieldTexture(const Heightfield& heightfield)
+{
+	TRACE_SCOPE("UploadHeightfieldTexture");
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	// rows of R16 data are only 2-byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, heightfield.format == HEIGHT_FORMAT::R16 ? 2 : 4);
+	if (heightfield.format == HEIGHT_FORMAT::R16)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, heightfield.width, heightfield.height, 0, GL_RED, GL_UNSIGNED_SHORT, heightfield.Data());
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, heightfield.width, heightfield.height, 0, GL_RED, GL_FLOAT, heightfield.Data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	return textureID;
+}
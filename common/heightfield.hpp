@@ -0,0 +1,48 @@
+#ifndef HEIGHTFIELD_HPP
+#define HEIGHTFIELD_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+
+enum class HEIGHT_FORMAT {
+	R16,   // unsigned 16 bit, 0..65535 maps to 0..1
+	R32F   // 32 bit float, used as is
+};
+
+// Height samples of the terrain, row-major (sample = row * width + col).
+// Only the vector matching format holds data.
+struct Heightfield {
+	int width;
+	int height;
+	HEIGHT_FORMAT format;
+	std::vector<unsigned short> r16;
+	std::vector<float> r32f;
+
+	Heightfield() : width(0), height(0), format(HEIGHT_FORMAT::R16) {}
+
+	float Sample(int row, int col) const {
+		size_t i = (size_t)row * width + col;
+		return format == HEIGHT_FORMAT::R16 ? r16[i] * (1.0f / 65535.0f) : r32f[i];
+	}
+	size_t ByteSize() const { return r16.size() * sizeof(unsigned short) + r32f.size() * sizeof(float); }
+	const void* Data() const { return format == HEIGHT_FORMAT::R16 ? (const void*)r16.data() : (const void*)r32f.data(); }
+};
+
+// Picks the loader from the file extension: .bmp, .pgm, .r16, .r32 or .thf (level 0, see terrain_tiles.hpp)
+// Raw files have no header and must be square.
+bool LoadHeightfield(const char* path, Heightfield& out);
+
+// 8/24/32 bit BMP, averaged to one channel and widened to R16
+bool LoadHeightfieldBMP(const char* path, Heightfield& out);
+
+// Binary PGM (P5), 8 or 16 bit samples, stored as R16
+bool LoadHeightfieldPGM(const char* path, Heightfield& out);
+
+// Headerless little-endian R16 or R32F samples. width/height <= 0: infer a square from the file size
+bool LoadHeightfieldRaw(const char* path, HEIGHT_FORMAT format, int width, int height, Heightfield& out);
+
+// Creates a GL_R16 or GL_R32F texture holding the samples (linear filtering, clamped, no mipmaps)
+GLuint UploadHeightfieldTexture(const Heightfield& heightfield);
+
+#endif
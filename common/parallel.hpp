@@ -0,0 +1,145 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <stddef.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use when the caller asks for "all cores" (threadCount <= 0)
+inline int ResolveThreadCount(int threadCount)
+{
+	if (threadCount > 0)
+		return threadCount;
+	int hw = (int)std::thread::hardware_concurrency();
+	return hw > 0 ? hw : 1;
+}
+
+// Splits [begin, end) into contiguous ranges and calls func(rangeBegin, rangeEnd) on each
+// from its own thread. The calling thread takes the first range. Ranges never overlap,
+// so func may write to disjoint parts of a shared output without locking.
+template<typename Func>
+void ParallelFor(int begin, int end, int threadCount, Func func)
+{
+	int count = end - begin;
+	if (count <= 0)
+		return;
+	threadCount = ResolveThreadCount(threadCount);
+	if (threadCount > count)
+		threadCount = count;
+	if (threadCount == 1) {
+		func(begin, end);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount - 1);
+	for (int t = 1; t < threadCount; t++) {
+		int b = begin + (int)((long long)count * t / threadCount);
+		int e = begin + (int)((long long)count * (t + 1) / threadCount);
+		workers.push_back(std::thread(func, b, e));
+	}
+	func(begin, begin + (int)((long long)count / threadCount));
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
+
+// Threads kept alive between ParallelFor calls, for work that runs every frame: starting a
+// std::thread costs tens of microseconds, waking a waiting one a few. Same range split as
+// ParallelFor above; the calling thread takes the first range. One caller at a time.
+class WorkerPool {
+public:
+	// threadCount counts the calling thread; <= 0: all cores
+	explicit WorkerPool(int threadCount = 0)
+		: threadCount(ResolveThreadCount(threadCount)), generation(0), pending(0), quit(false),
+		job(NULL), context(NULL), jobBegin(0), jobCount(0), jobThreads(0)
+	{
+		for (int t = 1; t < this->threadCount; t++)
+			workers.push_back(std::thread(&WorkerPool::WorkerLoop, this, t));
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (size_t t = 0; t < workers.size(); t++)
+			workers[t].join();
+	}
+
+	int GetThreadCount() const { return threadCount; }
+
+	template<typename Func>
+	void ParallelFor(int begin, int end, Func func)
+	{
+		int count = end - begin;
+		if (count <= 0)
+			return;
+		int threads = threadCount < count ? threadCount : count;
+		if (threads == 1) {
+			func(begin, end);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &Invoke<Func>;
+			context = &func;
+			jobBegin = begin;
+			jobCount = count;
+			jobThreads = threads;
+			pending = threads - 1;
+			generation++;
+		}
+		wake.notify_all();
+		func(begin, begin + (int)((long long)count / threads));
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return pending == 0; });
+	}
+
+private:
+	int threadCount;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	unsigned int generation;    // bumped for every job
+	int pending;                // workers still running the current job
+	bool quit;
+	void (*job)(void* context, int begin, int end);
+	void* context;
+	int jobBegin, jobCount, jobThreads;
+
+	template<typename Func>
+	static void Invoke(void* context, int begin, int end)
+	{
+		(*(Func*)context)(begin, end);
+	}
+
+	void WorkerLoop(int index)
+	{
+		unsigned int seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [&] { return quit || generation != seen; });
+			if (quit)
+				return;
+			seen = generation;
+			if (index >= jobThreads)
+				continue;   // fewer items than threads
+			const int b = jobBegin + (int)((long long)jobCount * index / jobThreads);
+			const int e = jobBegin + (int)((long long)jobCount * (index + 1) / jobThreads);
+			lock.unlock();
+			job(context, b, e);
+			lock.lock();
+			if (--pending == 0)
+				done.notify_one();
+		}
+	}
+
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+};
+
+#endif
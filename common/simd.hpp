@@ -0,0 +1,15 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+/*
+    SSE2 paths of the terrain code. SSE2 is always there on x64, so MSVC x64 builds get it
+    without flags. Define
+    #define TERRAIN_NO_SIMD
+    to build the scalar paths only.
+*/
+#if !defined(TERRAIN_NO_SIMD) && (defined(__SSE2__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))))
+#define TERRAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#endif
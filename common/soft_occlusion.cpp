@@ -0,0 +1,296 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "terrain_cull.hpp"
+#include "soft_occlusion.hpp"
+
+SoftwareOcclusion::SoftwareOcclusion(int width, int height, int threadCount)
+	: width((width + 3) & ~3), height(height), threadCount(ResolveThreadCount(threadCount)),
+	pool(this->threadCount), mvp(1.0f), tested(0), rejected(0)
+{
+	int w = this->width, h = this->height;
+	while (true) {
+		levels.push_back(std::vector<float>((size_t)w * h, 1.0f));
+		levelWidth.push_back(w);
+		levelHeight.push_back(h);
+		if (w == 1 && h == 1)
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+	binned.resize(this->threadCount);
+}
+
+void SoftwareOcclusion::BuildOccluders(const Heightfield& heights, int step, float spacing, float heightScale)
+{
+	if (step < 1) step = 1;
+	const int rows = (heights.height - 2) / step + 2;   // the last row/column lands on the border
+	const int cols = (heights.width - 2) / step + 2;
+	std::vector<glm::vec3> grid((size_t)rows * cols);
+	pool.ParallelFor(0, rows, [&](int rowBegin, int rowEnd) {
+		for (int r = rowBegin; r < rowEnd; r++) {
+			int sr = r * step < heights.height - 1 ? r * step : heights.height - 1;
+			for (int c = 0; c < cols; c++) {
+				int sc = c * step < heights.width - 1 ? c * step : heights.width - 1;
+				// min over every cell touching this vertex
+				float lo = 1e30f;
+				int r0 = sr - step > 0 ? sr - step : 0, r1 = sr + step < heights.height - 1 ? sr + step : heights.height - 1;
+				int c0 = sc - step > 0 ? sc - step : 0, c1 = sc + step < heights.width - 1 ? sc + step : heights.width - 1;
+				for (int y = r0; y <= r1; y++) {
+					for (int x = c0; x <= c1; x++) {
+						float h = heights.Sample(y, x);
+						lo = h < lo ? h : lo;
+					}
+				}
+				grid[(size_t)r * cols + c] = glm::vec3(sr * spacing, lo * heightScale, sc * spacing);
+			}
+		}
+	});
+
+	std::vector<unsigned int> list;
+	list.reserve((size_t)(rows - 1) * (cols - 1) * 6);
+	for (int r = 0; r < rows - 1; r++) {
+		for (int c = 0; c < cols - 1; c++) {
+			unsigned int v0 = r * cols + c, v1 = r * cols + c + 1;
+			unsigned int v2 = (r + 1) * cols + c + 1, v3 = (r + 1) * cols + c;
+			list.push_back(v0); list.push_back(v1); list.push_back(v2);
+			list.push_back(v0); list.push_back(v2); list.push_back(v3);
+		}
+	}
+	SetOccluders(grid, list);
+}
+
+void SoftwareOcclusion::SetOccluders(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+{
+	this->vertices = vertices;
+	this->indices = indices;
+	clip.resize(vertices.size());
+}
+
+// Triangle entirely in front of the near plane
+void SoftwareOcclusion::AddTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, std::vector<ScreenTriangle>& out) const
+{
+	const glm::vec4* v[3] = { &a, &b, &c };
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; i++) {
+		float invW = 1.0f / v[i]->w;
+		x[i] = (v[i]->x * invW * 0.5f + 0.5f) * width;
+		y[i] = (v[i]->y * invW * 0.5f + 0.5f) * height;
+		z[i] = v[i]->z * invW;
+	}
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (fabsf(area) < 1e-6f)
+		return;
+
+	// Pixels whose centre (i + 0.5) can be inside
+	float loX = fminf(x[0], fminf(x[1], x[2])), hiX = fmaxf(x[0], fmaxf(x[1], x[2]));
+	float loY = fminf(y[0], fminf(y[1], y[2])), hiY = fmaxf(y[0], fmaxf(y[1], y[2]));
+	ScreenTriangle t;
+	t.minX = (int)ceilf(loX - 0.5f); t.maxX = (int)floorf(hiX - 0.5f);
+	t.minY = (int)ceilf(loY - 0.5f); t.maxY = (int)floorf(hiY - 0.5f);
+	t.minX = t.minX < 0 ? 0 : t.minX; t.maxX = t.maxX > width - 1 ? width - 1 : t.maxX;
+	t.minY = t.minY < 0 ? 0 : t.minY; t.maxY = t.maxY > height - 1 ? height - 1 : t.maxY;
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return;
+
+	// Both windings are drawn: flip the edges of clockwise triangles
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		t.e[i][0] = (y[i] - y[j]) * sign;
+		t.e[i][1] = (x[j] - x[i]) * sign;
+		t.e[i][2] = (x[i] * y[j] - x[j] * y[i]) * sign;
+	}
+	t.dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	t.dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	t.z0 = z[0] - t.dzdx * x[0] - t.dzdy * y[0];
+	out.push_back(t);
+}
+
+// Clips against the near plane (z >= -w) and queues what is left
+void SoftwareOcclusion::SetupTriangles(size_t begin, size_t end, std::vector<ScreenTriangle>& out) const
+{
+	out.clear();
+	for (size_t i = begin; i < end; i++) {
+		const glm::vec4* v[3] = { &clip[indices[i * 3]], &clip[indices[i * 3 + 1]], &clip[indices[i * 3 + 2]] };
+		float d[3];
+		int inside = 0;
+		for (int k = 0; k < 3; k++) {
+			d[k] = v[k]->z + v[k]->w;
+			inside += d[k] >= 0.0f ? 1 : 0;
+		}
+		if (inside == 3) {
+			AddTriangle(*v[0], *v[1], *v[2], out);
+			continue;
+		}
+		if (inside == 0)
+			continue;
+		// Sutherland-Hodgman on one plane: at most 4 vertices
+		glm::vec4 poly[4];
+		int count = 0;
+		for (int k = 0; k < 3; k++) {
+			int n = (k + 1) % 3;
+			if (d[k] >= 0.0f)
+				poly[count++] = *v[k];
+			if ((d[k] >= 0.0f) != (d[n] >= 0.0f)) {
+				float t = d[k] / (d[k] - d[n]);
+				poly[count++] = *v[k] + (*v[n] - *v[k]) * t;
+			}
+		}
+		for (int k = 2; k < count; k++)
+			AddTriangle(poly[0], poly[k - 1], poly[k], out);
+	}
+}
+
+void SoftwareOcclusion::RasterizeBand(int rowBegin, int rowEnd)
+{
+	for (size_t list = 0; list < binned.size(); list++) {
+		for (size_t i = 0; i < binned[list].size(); i++) {
+			const ScreenTriangle& t = binned[list][i];
+			int y0 = t.minY > rowBegin ? t.minY : rowBegin;
+			int y1 = t.maxY < rowEnd - 1 ? t.maxY : rowEnd - 1;
+			for (int y = y0; y <= y1; y++) {
+				float* row = &levels[0][(size_t)y * width];
+				const float py = y + 0.5f;
+				int x = t.minX;
+#ifdef TERRAIN_SSE2
+				x &= ~3;
+				const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+				const __m128 zero = _mm_setzero_ps();
+				__m128 e[3], step[3];
+				for (int k = 0; k < 3; k++) {
+					e[k] = _mm_add_ps(_mm_set1_ps(t.e[k][0] * x + t.e[k][1] * py + t.e[k][2]), _mm_mul_ps(_mm_set1_ps(t.e[k][0]), offsets));
+					step[k] = _mm_set1_ps(t.e[k][0] * 4.0f);
+				}
+				__m128 z = _mm_add_ps(_mm_set1_ps(t.z0 + t.dzdx * x + t.dzdy * py), _mm_mul_ps(_mm_set1_ps(t.dzdx), offsets));
+				const __m128 zStep = _mm_set1_ps(t.dzdx * 4.0f);
+				for (; x <= t.maxX; x += 4) {
+					__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)), _mm_cmpge_ps(e[2], zero));
+					__m128 depth = _mm_loadu_ps(row + x);
+					__m128 nearer = _mm_min_ps(depth, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+					for (int k = 0; k < 3; k++)
+						e[k] = _mm_add_ps(e[k], step[k]);
+					z = _mm_add_ps(z, zStep);
+				}
+#else
+				for (; x <= t.maxX; x++) {
+					const float px = x + 0.5f;
+					if (t.e[0][0] * px + t.e[0][1] * py + t.e[0][2] >= 0.0f &&
+						t.e[1][0] * px + t.e[1][1] * py + t.e[1][2] >= 0.0f &&
+						t.e[2][0] * px + t.e[2][1] * py + t.e[2][2] >= 0.0f) {
+						float z = t.z0 + t.dzdx * px + t.dzdy * py;
+						row[x] = z < row[x] ? z : row[x];
+					}
+				}
+#endif
+			}
+		}
+	}
+}
+
+// Each texel keeps the farthest depth of the texels below it
+void SoftwareOcclusion::BuildPyramid()
+{
+	for (size_t l = 1; l < levels.size(); l++) {
+		const std::vector<float>& src = levels[l - 1];
+		std::vector<float>& dst = levels[l];
+		const int sw = levelWidth[l - 1], sh = levelHeight[l - 1];
+		for (int y = 0; y < levelHeight[l]; y++) {
+			int y0 = y * 2, y1 = y * 2 + 1 < sh ? y * 2 + 1 : y * 2;
+			for (int x = 0; x < levelWidth[l]; x++) {
+				int x0 = x * 2, x1 = x * 2 + 1 < sw ? x * 2 + 1 : x * 2;
+				float a = fmaxf(src[(size_t)y0 * sw + x0], src[(size_t)y0 * sw + x1]);
+				float b = fmaxf(src[(size_t)y1 * sw + x0], src[(size_t)y1 * sw + x1]);
+				dst[(size_t)y * levelWidth[l] + x] = fmaxf(a, b);
+			}
+		}
+	}
+}
+
+void SoftwareOcclusion::Render(const glm::mat4& mvp)
+{
+	this->mvp = mvp;
+	std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+
+	pool.ParallelFor(0, (int)vertices.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			clip[i] = mvp * glm::vec4(vertices[i], 1.0f);
+	});
+	// One setup list per thread, so no locking and no merge
+	const size_t triangles = indices.size() / 3;
+	const int lists = (int)binned.size();
+	pool.ParallelFor(0, lists, [&](int begin, int end) {
+		for (int l = begin; l < end; l++)
+			SetupTriangles(triangles * l / lists, triangles * (l + 1) / lists, binned[l]);
+	});
+	pool.ParallelFor(0, height, [&](int rowBegin, int rowEnd) {
+		RasterizeBand(rowBegin, rowEnd);
+	});
+	BuildPyramid();
+}
+
+size_t SoftwareOcclusion::GetTrianglesRasterized() const
+{
+	size_t count = 0;
+	for (size_t l = 0; l < binned.size(); l++)
+		count += binned[l].size();
+	return count;
+}
+
+bool SoftwareOcclusion::TestAabb(const glm::vec3& lo, const glm::vec3& hi) const
+{
+	float loX = 1e30f, hiX = -1e30f, loY = 1e30f, hiY = -1e30f, nearest = 1e30f;
+	for (int i = 0; i < 8; i++) {
+		glm::vec4 p = mvp * glm::vec4(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z, 1.0f);
+		if (p.z < -p.w)
+			return true;  // reaches the near plane: can't be hidden
+		float invW = 1.0f / p.w;
+		float x = (p.x * invW * 0.5f + 0.5f) * width, y = (p.y * invW * 0.5f + 0.5f) * height, z = p.z * invW;
+		loX = x < loX ? x : loX; hiX = x > hiX ? x : hiX;
+		loY = y < loY ? y : loY; hiY = y > hiY ? y : hiY;
+		nearest = z < nearest ? z : nearest;
+	}
+	// Occluders cover a pixel when they cover its centre, so a pixel on an occluder's silhouette
+	// may still show something behind it: grow the rect by one pixel to reach past silhouettes
+	int x0 = (int)floorf(loX) - 1, x1 = (int)floorf(hiX) + 1, y0 = (int)floorf(loY) - 1, y1 = (int)floorf(hiY) + 1;
+	x0 = x0 < 0 ? 0 : x0; x1 = x1 > width - 1 ? width - 1 : x1;
+	y0 = y0 < 0 ? 0 : y0; y1 = y1 > height - 1 ? height - 1 : y1;
+	if (x0 > x1 || y0 > y1)
+		return false;  // off screen
+
+	// Coarsest level where the rect still spans at most 4 x 4 texels
+	size_t l = 0;
+	while (l + 1 < levels.size() && ((x1 >> l) - (x0 >> l) > 3 || (y1 >> l) - (y0 >> l) > 3))
+		l++;
+	const std::vector<float>& depth = levels[l];
+	for (int y = y0 >> l; y <= (y1 >> l); y++) {
+		for (int x = x0 >> l; x <= (x1 >> l); x++) {
+			if (nearest <= depth[(size_t)y * levelWidth[l] + x])
+				return true;
+		}
+	}
+	return false;
+}
+
+void SoftwareOcclusion::Cull(const ChunkBounds& bounds, const std::vector<unsigned int>& candidates, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	tested = candidates.size();
+	rejected = 0;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		unsigned int c = candidates[i];
+		glm::vec3 lo(bounds.minX[c], bounds.minY[c], bounds.minZ[c]);
+		glm::vec3 hi(bounds.maxX[c], bounds.maxY[c], bounds.maxZ[c]);
+		if (TestAabb(lo, hi))
+			visible.push_back(c);
+		else
+			rejected++;
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef SOFT_OCCLUSION_HPP
+#define SOFT_OCCLUSION_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "terrain_cull.hpp"
+
+// Software occlusion culling on the CPU, no GPU involved.
+// A low-resolution occluder mesh is rasterised into a small depth buffer (NDC z, nearest wins)
+// by horizontal bands on threadCount threads (kept in a WorkerPool), four pixels per SSE2 step. A max-depth pyramid
+// is then built over it, so an AABB query reads a handful of texels: the box is hidden when
+// its nearest depth is behind the farthest occluder depth everywhere its screen rect covers.
+class SoftwareOcclusion {
+public:
+	// width is rounded up to a multiple of 4. threadCount <= 0: all cores.
+	SoftwareOcclusion(int width = 256, int height = 128, int threadCount = 0);
+
+	// Occluder mesh with one vertex every step samples. Vertex heights are the minimum over all
+	// cells touching the vertex, so the mesh stays under the terrain and never over-occludes.
+	void BuildOccluders(const Heightfield& heights, int step, float spacing, float heightScale);
+
+	// Any other occluder mesh (triangle list)
+	void SetOccluders(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+
+	// Clears, rasterises the occluders with mvp and builds the depth pyramid
+	void Render(const glm::mat4& mvp);
+
+	// false when the box is certainly hidden. Uses the mvp of the last Render.
+	bool TestAabb(const glm::vec3& lo, const glm::vec3& hi) const;
+
+	// Keeps the candidates (indices into bounds) that TestAabb can't reject
+	void Cull(const ChunkBounds& bounds, const std::vector<unsigned int>& candidates, std::vector<unsigned int>& visible);
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	const float* GetDepth() const { return &levels[0][0]; }
+	size_t GetOccluderTriangles() const { return indices.size() / 3; }
+	size_t GetTrianglesRasterized() const;    // last Render, after near clipping and rejection
+	size_t GetTested() const { return tested; }
+	size_t GetRejected() const { return rejected; }
+	float GetRejectedPercent() const { return tested ? 100.0f * rejected / tested : 0.0f; }
+
+private:
+	// Screen-space triangle ready for the band rasterisers
+	struct ScreenTriangle {
+		float e[3][3];                // edge functions a*x + b*y + c, >= 0 inside
+		float z0, dzdx, dzdy;         // depth plane at pixel (0, 0)
+		int minX, maxX, minY, maxY;   // pixel bounds, inclusive
+	};
+
+	int width, height;
+	int threadCount;
+	WorkerPool pool;                                    // threadCount threads with the caller
+	glm::mat4 mvp;
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec4> clip;                        // transformed vertices
+	std::vector<std::vector<ScreenTriangle> > binned;   // one list per setup thread
+	std::vector<std::vector<float> > levels;            // [0]: depth, then max pyramid
+	std::vector<int> levelWidth, levelHeight;
+	size_t tested, rejected;
+
+	void SetupTriangles(size_t begin, size_t end, std::vector<ScreenTriangle>& out) const;
+	void AddTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, std::vector<ScreenTriangle>& out) const;
+	void RasterizeBand(int rowBegin, int rowEnd);
+	void BuildPyramid();
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include "stream_buffer.hpp"
+
+StreamBuffer::StreamBuffer()
+	: buffer(0), mapped(NULL), persistent(false), frameBytes(0), frameCount(0), region(0), used(0), needed(0)
+{
+	memset(fences, 0, sizeof(fences));
+	memset(&stats, 0, sizeof(stats));
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	Release();
+}
+
+bool StreamBuffer::Init(size_t frameBytes, int frameCount)
+{
+	Shutdown();
+	if (frameCount < 2 || frameCount > MAX_FRAMES || frameBytes == 0) {
+		printf("StreamBuffer: bad size %zu x %d\n", frameBytes, frameCount);
+		return false;
+	}
+	this->frameBytes = frameBytes;
+	this->frameCount = frameCount;
+	persistent = GLEW_ARB_buffer_storage != 0;
+	memset(&stats, 0, sizeof(stats));
+	return Allocate();
+}
+
+void StreamBuffer::Shutdown()
+{
+	Release();
+	frameBytes = 0;
+	frameCount = 0;
+}
+
+bool StreamBuffer::Allocate()
+{
+	const GLsizeiptr total = (GLsizeiptr)(frameBytes * frameCount);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, total, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+		if (mapped == NULL) {
+			printf("StreamBuffer: persistent mapping failed, orphaning instead\n");
+			glDeleteBuffers(1, &buffer);
+			persistent = false;
+			return Allocate();
+		}
+	}
+	else {
+		glBufferData(GL_COPY_WRITE_BUFFER, total, NULL, GL_STREAM_DRAW);
+	}
+	region = 0;
+	used = 0;
+	return true;
+}
+
+void StreamBuffer::Release()
+{
+	for (int f = 0; f < MAX_FRAMES; f++) {
+		if (fences[f])
+			glDeleteSync(fences[f]);
+		fences[f] = 0;
+	}
+	if (buffer) {
+		if (mapped) {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = 0;
+	mapped = NULL;
+}
+
+void StreamBuffer::BeginFrame()
+{
+	if (!buffer)
+		return;
+	stats.waitMs = 0.0f;
+	if (needed > 0) {
+		// The old buffer stays alive in the driver until the GPU is done with it
+		size_t grown = frameBytes * 2;
+		while (grown < needed)
+			grown *= 2;
+		printf("StreamBuffer: growing to %zu KB per frame\n", grown / 1024);
+		Release();
+		frameBytes = grown;
+		needed = 0;
+		stats.reallocations++;
+		Allocate();
+		return;
+	}
+
+	region = (region + 1) % frameCount;
+	used = 0;
+	GLsync& fence = fences[region];
+	if (!fence)
+		return;
+	if (persistent) {
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			stats.waits++;
+			do {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+			stats.waitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+	else if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+		// GPU still reading: new storage for the whole ring, older fences no longer matter
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(frameBytes * frameCount), NULL, GL_STREAM_DRAW);
+		stats.orphans++;
+		for (int f = 0; f < frameCount; f++) {
+			if (fences[f])
+				glDeleteSync(fences[f]);
+			fences[f] = 0;
+		}
+	}
+	else {
+		glDeleteSync(fence);
+		fence = 0;
+	}
+}
+
+bool StreamBuffer::Write(const void* data, size_t size, size_t alignment, size_t& offset)
+{
+	if (!buffer || size == 0)
+		return false;
+	size_t start = (used + alignment - 1) / alignment * alignment;
+	if (start + size > frameBytes) {
+		stats.overflows++;
+		if (start + size > needed)
+			needed = start + size;
+		return false;
+	}
+	offset = (size_t)region * frameBytes + start;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (mapped) {
+		memcpy(mapped + offset, data, size);
+	}
+	else {
+		void* dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (dst == NULL)
+			return false;
+		memcpy(dst, data, size);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	used = start + size;
+	return true;
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (!buffer)
+		return;
+	if (fences[region])
+		glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stats.bytesWritten = used;
+	if (used > stats.peakBytes)
+		stats.peakBytes = used;
+}
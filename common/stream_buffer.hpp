@@ -0,0 +1,66 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+
+#include <stddef.h>
+#include <GL/glew.h>
+
+// Ring buffer for data that is written once per frame and read by the GPU in that frame
+// (vertex/index data, pixel unpack sources).
+//
+// The buffer is split into frameCount regions; BeginFrame moves to the next one and EndFrame
+// puts a fence behind it, so a region is only rewritten after the GPU has finished the frame that
+// used it. With GL_ARB_buffer_storage the buffer is mapped once, persistently and coherently, and
+// Write is a memcpy; BeginFrame waits on the fence (which with 3 regions should not happen).
+// Without it every Write maps its range unsynchronized, and a region whose fence has not signalled
+// yet is orphaned instead of waited for.
+//
+// A frame that writes more than frameBytes makes Write fail (the caller uploads the usual way)
+// and the next BeginFrame reallocates a larger buffer.
+class StreamBuffer {
+public:
+	struct Stats {
+		size_t bytesWritten;    // last frame
+		size_t peakBytes;       // largest frame since Init
+		size_t waits;           // BeginFrame calls that blocked on a fence, since Init
+		size_t orphans;         // regions orphaned instead (no persistent mapping)
+		size_t overflows;       // failed Writes
+		size_t reallocations;
+		float waitMs;           // last BeginFrame
+	};
+
+	StreamBuffer();
+	~StreamBuffer();
+
+	bool Init(size_t frameBytes, int frameCount = 3);
+	void Shutdown();
+
+	void BeginFrame();
+	// Copies size bytes into this frame's region at a multiple of alignment (any value >= 1).
+	// offset is relative to GetBuffer(). The buffer is bound to GL_COPY_WRITE_BUFFER.
+	bool Write(const void* data, size_t size, size_t alignment, size_t& offset);
+	void EndFrame();
+
+	GLuint GetBuffer() const { return buffer; }
+	bool IsPersistent() const { return mapped != NULL; }
+	size_t GetFrameBytes() const { return frameBytes; }
+	const Stats& GetStats() const { return stats; }
+
+private:
+	static const int MAX_FRAMES = 4;
+
+	GLuint buffer;
+	unsigned char* mapped;      // persistent mapping, NULL when orphaning
+	bool persistent;            // GL_ARB_buffer_storage available
+	size_t frameBytes;
+	int frameCount;
+	int region;                 // region of the current frame
+	size_t used;                // bytes of the current region
+	size_t needed;              // bytes a frame asked for when it overflowed
+	GLsync fences[MAX_FRAMES];
+	Stats stats;
+
+	bool Allocate();
+	void Release();
+};
+
+#endif
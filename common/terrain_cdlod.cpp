@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "terrain_cdlod.hpp"
+#include "trace.hpp"
+
+CdlodTerrain::CdlodTerrain()
+	: leafSize(0), spacing(1.0f), morphStart(0.7f), nodesVisited(0), indexBuffer(0)
+{
+	for (int i = 0; i < 5; i++)
+		partFirst[i] = partCount[i] = 0;
+}
+
+CdlodTerrain::~CdlodTerrain()
+{
+	if (indexBuffer)
+		glDeleteBuffers(1, &indexBuffer);
+}
+
+bool CdlodTerrain::Init(const Heightfield& heights, int leafSize, float spacing, float heightScale)
+{
+	TRACE_SCOPE("CdlodTerrain::Init");
+	if (leafSize < 8 || leafSize > 128 || (leafSize & (leafSize - 1)) != 0) {
+		printf("CDLOD: leaf size %d is not a power of two\n", leafSize);
+		return false;
+	}
+
+	// Leaf bounds over the leaf's vertices, including the ones shared with its neighbours
+	const int leavesX = (heights.width - 2) / leafSize + 1;
+	const int leavesZ = (heights.height - 2) / leafSize + 1;
+	std::vector<float> leafMin((size_t)leavesX * leavesZ), leafMax((size_t)leavesX * leavesZ);
+	ParallelFor(0, leavesZ, 0, [&](int zBegin, int zEnd) {
+		for (int lz = zBegin; lz < zEnd; lz++) {
+			for (int lx = 0; lx < leavesX; lx++) {
+				float lo = 1e30f, hi = -1e30f;
+				int rowEnd = (lz + 1) * leafSize < heights.height - 1 ? (lz + 1) * leafSize : heights.height - 1;
+				int colEnd = (lx + 1) * leafSize < heights.width - 1 ? (lx + 1) * leafSize : heights.width - 1;
+				for (int r = lz * leafSize; r <= rowEnd; r++) {
+					for (int c = lx * leafSize; c <= colEnd; c++) {
+						float y = heights.Sample(r, c) * heightScale;
+						lo = y < lo ? y : lo;
+						hi = y > hi ? y : hi;
+					}
+				}
+				leafMin[(size_t)lz * leavesX + lx] = lo;
+				leafMax[(size_t)lz * leavesX + lx] = hi;
+			}
+		}
+	});
+	InitBounds(heights.width, heights.height, leafSize, spacing, leafMin, leafMax);
+
+	// One leafSize x leafSize grid (vertex id = row * (leafSize + 1) + col), then its quarters
+	const int verts = leafSize + 1;
+	const int half = leafSize / 2;
+	std::vector<GLushort> indices;
+	for (int part = 0; part < 5; part++) {
+		int r0 = part == 0 ? 0 : ((part - 1) / 2) * half;
+		int c0 = part == 0 ? 0 : ((part - 1) % 2) * half;
+		int n = part == 0 ? leafSize : half;
+		partFirst[part] = (GLsizei)indices.size();
+		for (int r = r0; r < r0 + n; r++) {
+			for (int c = c0; c < c0 + n; c++) {
+				GLushort v0 = (GLushort)(r * verts + c), v1 = (GLushort)(r * verts + c + 1);
+				GLushort v2 = (GLushort)((r + 1) * verts + c + 1), v3 = (GLushort)((r + 1) * verts + c);
+				indices.push_back(v0); indices.push_back(v1); indices.push_back(v2);
+				indices.push_back(v0); indices.push_back(v2); indices.push_back(v3);
+			}
+		}
+		partCount[part] = (GLsizei)indices.size() - partFirst[part];
+	}
+	if (!indexBuffer)
+		glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+	return true;
+}
+
+void CdlodTerrain::InitBounds(int width, int height, int leafSize, float spacing,
+	const std::vector<float>& leafMin, const std::vector<float>& leafMax)
+{
+	this->leafSize = leafSize;
+	this->spacing = spacing;
+	levels.clear();
+
+	Level leaves;
+	leaves.nodesX = (width - 2) / leafSize + 1;
+	leaves.nodesZ = (height - 2) / leafSize + 1;
+	leaves.minY = leafMin;
+	leaves.maxY = leafMax;
+	levels.push_back(leaves);
+
+	// Parents merge up to four children until one node covers the map
+	while (levels.back().nodesX > 1 || levels.back().nodesZ > 1) {
+		const Level& child = levels.back();
+		Level parent;
+		parent.nodesX = (child.nodesX + 1) / 2;
+		parent.nodesZ = (child.nodesZ + 1) / 2;
+		parent.minY.assign((size_t)parent.nodesX * parent.nodesZ, 1e30f);
+		parent.maxY.assign((size_t)parent.nodesX * parent.nodesZ, -1e30f);
+		for (int z = 0; z < child.nodesZ; z++) {
+			for (int x = 0; x < child.nodesX; x++) {
+				size_t c = (size_t)z * child.nodesX + x;
+				size_t p = (size_t)(z / 2) * parent.nodesX + x / 2;
+				parent.minY[p] = child.minY[c] < parent.minY[p] ? child.minY[c] : parent.minY[p];
+				parent.maxY[p] = child.maxY[c] > parent.maxY[p] ? child.maxY[c] : parent.maxY[p];
+			}
+		}
+		levels.push_back(parent);
+	}
+	SetLodRanges(leafSize * spacing * 2.0f, morphStart);
+}
+
+void CdlodTerrain::SetLodRanges(float firstRange, float morphStart)
+{
+	this->morphStart = morphStart;
+	ranges.resize(levels.size());
+	for (size_t l = 0; l < ranges.size(); l++)
+		ranges[l] = firstRange * (float)(1 << l);
+}
+
+bool CdlodTerrain::NodeInSphere(int level, int nx, int nz, const glm::vec3& center, float radius) const
+{
+	const Level& lv = levels[level];
+	const size_t i = (size_t)nz * lv.nodesX + nx;
+	const float size = (float)(leafSize << level) * spacing;
+	// x follows heightfield rows, z follows columns
+	const float x0 = nz * size, z0 = nx * size;
+	float dx = center.x < x0 ? x0 - center.x : (center.x > x0 + size ? center.x - x0 - size : 0.0f);
+	float dy = center.y < lv.minY[i] ? lv.minY[i] - center.y : (center.y > lv.maxY[i] ? center.y - lv.maxY[i] : 0.0f);
+	float dz = center.z < z0 ? z0 - center.z : (center.z > z0 + size ? center.z - z0 - size : 0.0f);
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+// Returns false when the node is beyond its level's range, leaving it to the parent
+bool CdlodTerrain::SelectNode(int level, int nx, int nz, const glm::vec3& camera)
+{
+	nodesVisited++;
+	if (!NodeInSphere(level, nx, nz, camera, ranges[level]))
+		return false;
+
+	const int size = leafSize << level;
+	SelectedNode node;
+	node.level = level;
+	node.col = nx * size;
+	node.row = nz * size;
+	node.part = 0;
+	if (level == 0 || !NodeInSphere(level, nx, nz, camera, ranges[level - 1])) {
+		selection.push_back(node);
+		return true;
+	}
+
+	// Children the finer level can't cover are drawn as quarters at this level
+	const Level& child = levels[level - 1];
+	for (int q = 0; q < 4; q++) {
+		int cx = nx * 2 + q % 2, cz = nz * 2 + q / 2;
+		if (cx >= child.nodesX || cz >= child.nodesZ)
+			continue;
+		if (!SelectNode(level - 1, cx, cz, camera)) {
+			node.part = q + 1;
+			selection.push_back(node);
+		}
+	}
+	return true;
+}
+
+void CdlodTerrain::Select(const glm::vec3& camera)
+{
+	selection.clear();
+	nodesVisited = 0;
+	const int top = (int)levels.size() - 1;
+	const int size = leafSize << top;
+	for (int nz = 0; nz < levels[top].nodesZ; nz++) {
+		for (int nx = 0; nx < levels[top].nodesX; nx++) {
+			if (!SelectNode(top, nx, nz, camera)) {
+				SelectedNode node = { top, nx * size, nz * size, 0 };
+				selection.push_back(node);
+			}
+		}
+	}
+}
+
+void CdlodTerrain::Draw(const Uniforms& uniforms) const
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	for (size_t i = 0; i < selection.size(); i++) {
+		const SelectedNode& node = selection[i];
+		float rangeEnd = ranges[node.level];
+		float rangeBegin = node.level > 0 ? ranges[node.level - 1] : 0.0f;
+		glUniform2i(uniforms.nodeOrigin, node.col, node.row);
+		glUniform1i(uniforms.nodeStep, 1 << node.level);
+		glUniform2f(uniforms.morphRange, rangeBegin + (rangeEnd - rangeBegin) * morphStart, rangeEnd);
+		glDrawElements(GL_TRIANGLES, partCount[node.part], GL_UNSIGNED_SHORT, (void*)(partFirst[node.part] * sizeof(GLushort)));
+	}
+}
+
+size_t CdlodTerrain::GetTriangleCount() const
+{
+	size_t triangles = 0;
+	for (size_t i = 0; i < selection.size(); i++)
+		triangles += (size_t)(selection[i].part == 0 ? leafSize * leafSize : leafSize * leafSize / 4) * 2;
+	return triangles;
+}
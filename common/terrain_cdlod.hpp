@@ -0,0 +1,79 @@
+#ifndef TERRAIN_CDLOD_HPP
+#define TERRAIN_CDLOD_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+
+// Continuous Distance-Dependent LOD (Strugar 2010).
+// A quadtree over the heightfield stores min/max height per node. Leaves cover leafSize
+// quads, every level above doubles that. Each frame the tree is walked against concentric
+// LOD ranges around the camera and every selected node (or node quarter) is drawn with the
+// same leafSize x leafSize grid, stretched by 2^level. shader/cdlod_vertexshader.glsl morphs
+// vertices toward the next coarser grid as they approach the end of their range, so there is
+// no popping and no stitching.
+class CdlodTerrain {
+public:
+	// Uniform locations of the CDLOD program
+	struct Uniforms {
+		GLint nodeOrigin;
+		GLint nodeStep;
+		GLint morphRange;
+	};
+
+	CdlodTerrain();
+	~CdlodTerrain();
+
+	// Builds the min/max tree from the heightfield and creates the grid index buffer.
+	// leafSize must be a power of two (8..128).
+	bool Init(const Heightfield& heights, int leafSize, float spacing, float heightScale);
+
+	// Builds the tree from precomputed leaf bounds (row-major, ceil((w-1)/leafSize) per row).
+	// Needs no GL context.
+	void InitBounds(int width, int height, int leafSize, float spacing,
+		const std::vector<float>& leafMin, const std::vector<float>& leafMax);
+
+	// firstRange: view distance covered by the finest level; each level doubles it.
+	// Vertices start morphing at morphStart (0..1) of the way through their range.
+	void SetLodRanges(float firstRange, float morphStart);
+
+	// camera in model space
+	void Select(const glm::vec3& camera);
+
+	// Program must be bound with gridSize = GetLeafSize() and cameraPosition set
+	void Draw(const Uniforms& uniforms) const;
+
+	int GetLeafSize() const { return leafSize; }
+	int GetLevelCount() const { return (int)levels.size(); }
+	size_t GetNodesVisited() const { return nodesVisited; }
+	size_t GetSelectedCount() const { return selection.size(); }
+	size_t GetTriangleCount() const;
+
+private:
+	struct Level {
+		int nodesX, nodesZ;               // nodes along columns / rows
+		std::vector<float> minY, maxY;
+	};
+	struct SelectedNode {
+		int level;
+		int col, row;                     // first heightfield texel
+		int part;                         // 0: whole node, 1..4: one quarter
+	};
+
+	int leafSize;
+	float spacing;
+	float morphStart;
+	std::vector<Level> levels;            // [0] = leaves
+	std::vector<float> ranges;            // per level
+	std::vector<SelectedNode> selection;
+	size_t nodesVisited;
+	GLuint indexBuffer;
+	GLsizei partFirst[5], partCount[5];   // whole grid and its four quarters
+
+	bool SelectNode(int level, int nx, int nz, const glm::vec3& camera);
+	bool NodeInSphere(int level, int nx, int nz, const glm::vec3& center, float radius) const;
+};
+
+#endif
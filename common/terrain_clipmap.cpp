@@ -0,0 +1,211 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "terrain_clipmap.hpp"
+#include "trace.hpp"
+
+ClipmapTerrain::ClipmapTerrain()
+	: heights(NULL), levelCount(0), levelSize(0), spacing(1.0f), bytesPerSample(2),
+	holeBase(0), texture(0), indexBuffer(0), bytesUploaded(0), uploadBuffer(NULL)
+{
+	memset(variants, 0, sizeof(variants));
+}
+
+ClipmapTerrain::~ClipmapTerrain()
+{
+	if (texture)
+		glDeleteTextures(1, &texture);
+	if (indexBuffer)
+		glDeleteBuffers(1, &indexBuffer);
+}
+
+bool ClipmapTerrain::Init(const Heightfield& heights, int levelCount, int levelSize, float spacing, bool createGL)
+{
+	TRACE_SCOPE("ClipmapTerrain::Init");
+	if (levelSize < 16 || levelSize > 1024 || (levelSize & (levelSize - 1)) != 0) {
+		printf("Clipmap: level size %d is not a power of two\n", levelSize);
+		return false;
+	}
+	if (levelCount < 1 || levelCount > 16) {
+		printf("Clipmap: bad level count %d\n", levelCount);
+		return false;
+	}
+	this->heights = &heights;
+	this->levelCount = levelCount;
+	this->levelSize = levelSize;
+	this->spacing = spacing;
+	bytesPerSample = heights.format == HEIGHT_FORMAT::R16 ? sizeof(unsigned short) : sizeof(float);
+	originCol.assign(levelCount, 0);
+	originRow.assign(levelCount, 0);
+	valid.assign(levelCount, false);
+	// A level spans 2H quads and the finer one H of its quads, with H odd since levelSize is a power
+	// of two. Snapping origins to even samples keeps the hole at offset H/2 .. H/2 + 2.
+	holeBase = (levelSize - 2) / 4;
+
+	std::vector<GLushort> indices;
+	BuildIndices(indices);
+	if (!createGL)
+		return true;
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	if (heights.format == HEIGHT_FORMAT::R16)
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, levelSize, levelSize, levelCount, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+	else
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, levelSize, levelSize, levelCount, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+	return true;
+}
+
+// Ring variants for the nine possible hole positions, then the full grid of the finest level
+void ClipmapTerrain::BuildIndices(std::vector<GLushort>& indices)
+{
+	const int verts = levelSize - 1;
+	const int quads = verts - 1;
+	const int hole = quads / 2;
+	indices.clear();
+	for (int v = 0; v < 10; v++) {
+		int holeCol = holeBase + v % 3, holeRow = holeBase + v / 3;
+		variants[v].firstIndex = (GLsizei)indices.size();
+		for (int r = 0; r < quads; r++) {
+			for (int c = 0; c < quads; c++) {
+				if (v < 9 && r >= holeRow && r < holeRow + hole && c >= holeCol && c < holeCol + hole)
+					continue;
+				GLushort v0 = (GLushort)(r * verts + c), v1 = (GLushort)(r * verts + c + 1);
+				GLushort v2 = (GLushort)((r + 1) * verts + c + 1), v3 = (GLushort)((r + 1) * verts + c);
+				indices.push_back(v0); indices.push_back(v1); indices.push_back(v2);
+				indices.push_back(v0); indices.push_back(v2); indices.push_back(v3);
+			}
+		}
+		variants[v].indexCount = (GLsizei)indices.size() - variants[v].firstIndex;
+	}
+}
+
+// Uploads the samples [col, col + cols) x [row, row + rows) of a level, split where they wrap
+void ClipmapTerrain::UploadRegion(int level, int col, int row, int cols, int rows)
+{
+	const int mask = levelSize - 1;
+	const int step = 1 << level;
+	for (int r = row; r < row + rows; ) {
+		int pieceRows = levelSize - (r & mask);
+		pieceRows = pieceRows < row + rows - r ? pieceRows : row + rows - r;
+		for (int c = col; c < col + cols; ) {
+			int pieceCols = levelSize - (c & mask);
+			pieceCols = pieceCols < col + cols - c ? pieceCols : col + cols - c;
+
+			// Point samples, clamped to the map
+			staging.resize((size_t)pieceCols * pieceRows * bytesPerSample);
+			for (int y = 0; y < pieceRows; y++) {
+				int srcRow = (r + y) * step;
+				srcRow = srcRow < 0 ? 0 : (srcRow >= heights->height ? heights->height - 1 : srcRow);
+				for (int x = 0; x < pieceCols; x++) {
+					int srcCol = (c + x) * step;
+					srcCol = srcCol < 0 ? 0 : (srcCol >= heights->width ? heights->width - 1 : srcCol);
+					size_t src = (size_t)srcRow * heights->width + srcCol;
+					size_t dst = (size_t)y * pieceCols + x;
+					if (heights->format == HEIGHT_FORMAT::R16)
+						((unsigned short*)&staging[0])[dst] = heights->r16[src];
+					else
+						((float*)&staging[0])[dst] = heights->r32f[src];
+				}
+			}
+			if (texture) {
+				const GLenum type = heights->format == HEIGHT_FORMAT::R16 ? GL_UNSIGNED_SHORT : GL_FLOAT;
+				size_t offset = 0;
+				glPixelStorei(GL_UNPACK_ALIGNMENT, (GLint)bytesPerSample);
+				if (uploadBuffer && uploadBuffer->Write(&staging[0], staging.size(), bytesPerSample, offset)) {
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer->GetBuffer());
+					glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, c & mask, r & mask, level, pieceCols, pieceRows, 1, GL_RED,
+						type, (void*)offset);
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				}
+				else {
+					glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, c & mask, r & mask, level, pieceCols, pieceRows, 1, GL_RED,
+						type, &staging[0]);
+				}
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			}
+			bytesUploaded += staging.size();
+			c += pieceCols;
+		}
+		r += pieceRows;
+	}
+}
+
+void ClipmapTerrain::Update(const glm::vec3& camera)
+{
+	TRACE_SCOPE("ClipmapTerrain::Update");
+	bytesUploaded = 0;
+	if (texture)
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	const int verts = levelSize - 1;
+	const int half = (verts - 1) / 2;
+	for (int l = 0; l < levelCount; l++) {
+		// x follows heightfield rows, z follows columns
+		const float step = (float)(1 << l) * spacing;
+		int col = (int)floorf((camera.z / step - half) * 0.5f) * 2;
+		int row = (int)floorf((camera.x / step - half) * 0.5f) * 2;
+		int oldCol = originCol[l], oldRow = originRow[l];
+		originCol[l] = col;
+		originRow[l] = row;
+
+		if (!valid[l] || abs(col - oldCol) >= verts || abs(row - oldRow) >= verts) {
+			UploadRegion(l, col, row, verts, verts);
+			valid[l] = true;
+			continue;
+		}
+		// Newly exposed columns over the full height, then newly exposed rows over the kept columns
+		if (col > oldCol)
+			UploadRegion(l, oldCol + verts, row, col - oldCol, verts);
+		else if (col < oldCol)
+			UploadRegion(l, col, row, oldCol - col, verts);
+		int keepBegin = col > oldCol ? col : oldCol;
+		int keepEnd = (col < oldCol ? col : oldCol) + verts;
+		if (row > oldRow)
+			UploadRegion(l, keepBegin, oldRow + verts, keepEnd - keepBegin, row - oldRow);
+		else if (row < oldRow)
+			UploadRegion(l, keepBegin, row, keepEnd - keepBegin, oldRow - row);
+	}
+}
+
+int ClipmapTerrain::VariantOf(int level) const
+{
+	if (level == 0)
+		return 9;
+	int holeCol = originCol[level - 1] / 2 - originCol[level] - holeBase;
+	int holeRow = originRow[level - 1] / 2 - originRow[level] - holeBase;
+	holeCol = holeCol < 0 ? 0 : (holeCol > 2 ? 2 : holeCol);
+	holeRow = holeRow < 0 ? 0 : (holeRow > 2 ? 2 : holeRow);
+	return holeRow * 3 + holeCol;
+}
+
+void ClipmapTerrain::Draw(const Uniforms& uniforms) const
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	for (int l = 0; l < levelCount; l++) {
+		const Variant& variant = variants[VariantOf(l)];
+		glUniform1i(uniforms.level, l);
+		glUniform2i(uniforms.levelOrigin, originCol[l], originRow[l]);
+		glDrawElements(GL_TRIANGLES, variant.indexCount, GL_UNSIGNED_SHORT, (void*)(variant.firstIndex * sizeof(GLushort)));
+	}
+}
+
+size_t ClipmapTerrain::GetTriangleCount() const
+{
+	size_t triangles = 0;
+	for (int l = 0; l < levelCount; l++)
+		triangles += variants[VariantOf(l)].indexCount / 3;
+	return triangles;
+}
@@ -0,0 +1,80 @@
+#ifndef TERRAIN_CLIPMAP_HPP
+#define TERRAIN_CLIPMAP_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "stream_buffer.hpp"
+
+// Geometry clipmap (Losasso & Hoppe 2004).
+// levelCount nested square grids of n = levelSize - 1 vertices are centred on the camera,
+// level l with a vertex step of 2^l heightfield samples. Each level's samples live in one layer
+// of a levelSize x levelSize texture array that is addressed toroidally (sample & (levelSize-1)),
+// so when the camera moves only the newly exposed L-shaped strip of every level is uploaded:
+// the per-frame upload is O(levelSize * distance moved), independent of the map size.
+//
+// Coarse levels point-sample the heightfield. Every level except the finest leaves a hole for
+// the next finer one; shader/clipmap_vertexshader.glsl snaps odd vertices on a level's outer edge
+// onto the coarser edge so the rings meet without cracks.
+class ClipmapTerrain {
+public:
+	// Uniform locations of the clipmap program
+	struct Uniforms {
+		GLint level;
+		GLint levelOrigin;
+	};
+
+	ClipmapTerrain();
+	~ClipmapTerrain();
+
+	// heights must outlive the clipmap. levelSize must be a power of two (16..1024).
+	// Without createGL only the CPU side runs, which is enough to measure uploads.
+	bool Init(const Heightfield& heights, int levelCount, int levelSize, float spacing, bool createGL = true);
+
+	// Strips are copied into buffer and uploaded from there (pixel unpack) instead of client memory
+	void SetUploadBuffer(StreamBuffer* buffer) { uploadBuffer = buffer; }
+
+	// Recentres the levels on the camera (model space) and uploads the exposed strips
+	void Update(const glm::vec3& camera);
+
+	// Program must be bound with gridVerts = GetGridVertices(), levelCount and levelSize set
+	void Draw(const Uniforms& uniforms) const;
+
+	GLuint GetTexture() const { return texture; }
+	int GetLevelCount() const { return levelCount; }
+	int GetLevelSize() const { return levelSize; }
+	int GetGridVertices() const { return levelSize - 1; }
+	size_t GetBytesUploaded() const { return bytesUploaded; }   // last Update
+	size_t GetTextureBytes() const { return (size_t)levelSize * levelSize * levelCount * bytesPerSample; }
+	size_t GetTriangleCount() const;
+
+private:
+	struct Variant {
+		GLsizei firstIndex;
+		GLsizei indexCount;
+	};
+
+	const Heightfield* heights;
+	int levelCount;
+	int levelSize;
+	float spacing;
+	size_t bytesPerSample;
+	std::vector<int> originCol, originRow;   // per level, in level samples (always even)
+	std::vector<bool> valid;
+	std::vector<unsigned char> staging;
+	Variant variants[10];                    // [0..8]: ring, hole offset (base + i % 3, base + i / 3); [9]: full grid
+	int holeBase;
+	GLuint texture;
+	GLuint indexBuffer;
+	size_t bytesUploaded;
+	StreamBuffer* uploadBuffer;
+
+	void UploadRegion(int level, int col, int row, int cols, int rows);
+	void BuildIndices(std::vector<GLushort>& indices);
+	int VariantOf(int level) const;
+};
+
+#endif
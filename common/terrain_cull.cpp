@@ -0,0 +1,98 @@
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "terrain_index.hpp"
+#include "terrain_cull.hpp"
+
+void ExtractFrustumPlanes(const glm::mat4& mvp, glm::vec4 planes[6])
+{
+	// glm is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+	planes[0] = row[3] + row[0];
+	planes[1] = row[3] - row[0];
+	planes[2] = row[3] + row[1];
+	planes[3] = row[3] - row[1];
+	planes[4] = row[3] + row[2];
+	planes[5] = row[3] - row[2];
+}
+
+void CullChunks(const glm::vec4 planes[6], const ChunkBounds& bounds, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	const size_t count = bounds.Count();
+	if (count == 0)
+		return;
+	visible.reserve(count);
+
+	// The corner furthest along each plane normal only depends on the normal's signs,
+	// so every plane reads from a fixed choice of min/max arrays
+	const float* px[6];
+	const float* py[6];
+	const float* pz[6];
+	for (int p = 0; p < 6; p++) {
+		px[p] = planes[p].x >= 0.0f ? &bounds.maxX[0] : &bounds.minX[0];
+		py[p] = planes[p].y >= 0.0f ? &bounds.maxY[0] : &bounds.minY[0];
+		pz[p] = planes[p].z >= 0.0f ? &bounds.maxZ[0] : &bounds.minZ[0];
+	}
+
+	size_t i = 0;
+#ifdef TERRAIN_SSE2
+	__m128 nx[6], ny[6], nz[6], nw[6];
+	for (int p = 0; p < 6; p++) {
+		nx[p] = _mm_set1_ps(planes[p].x);
+		ny[p] = _mm_set1_ps(planes[p].y);
+		nz[p] = _mm_set1_ps(planes[p].z);
+		nw[p] = _mm_set1_ps(planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4) {
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++) {
+			__m128 d = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(nx[p], _mm_loadu_ps(px[p] + i)), _mm_mul_ps(ny[p], _mm_loadu_ps(py[p] + i))),
+				_mm_add_ps(_mm_mul_ps(nz[p], _mm_loadu_ps(pz[p] + i)), nw[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; k++) {
+			if (mask & (1 << k))
+				visible.push_back((unsigned int)(i + k));
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+			inside = planes[p].x * px[p][i] + planes[p].y * py[p][i] + planes[p].z * pz[p][i] + planes[p].w >= 0.0f;
+		if (inside)
+			visible.push_back((unsigned int)i);
+	}
+}
+
+void ComputePatchBounds(const Heightfield& heights, const TerrainPatchSet& patches,
+	float spacing, float heightScale, ChunkBounds& out, int threadCount)
+{
+	out.Resize(patches.patches.size());
+	ParallelFor(0, (int)patches.patches.size(), threadCount, [&](int begin, int end) {
+		for (int p = begin; p < end; p++) {
+			const TerrainPatch& patch = patches.patches[p];
+			float lo = 1e30f, hi = -1e30f;
+			for (int r = patch.row; r < patch.row + patch.rows; r++) {
+				for (int c = patch.col; c < patch.col + patch.cols; c++) {
+					float y = heights.Sample(r, c) * heightScale;
+					lo = y < lo ? y : lo;
+					hi = y > hi ? y : hi;
+				}
+			}
+			// x follows rows, z follows columns
+			out.Set(p, glm::vec3(patch.row * spacing, lo, patch.col * spacing),
+				glm::vec3((patch.row + patch.rows - 1) * spacing, hi, (patch.col + patch.cols - 1) * spacing));
+		}
+	});
+}
@@ -0,0 +1,56 @@
+#ifndef TERRAIN_CULL_HPP
+#define TERRAIN_CULL_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "terrain_index.hpp"
+
+// Axis-aligned chunk bounds, one array per component so the culling loop
+// tests four chunks per SSE instruction
+struct ChunkBounds {
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	size_t Count() const { return minX.size(); }
+	void Resize(size_t count)
+	{
+		minX.resize(count); minY.resize(count); minZ.resize(count);
+		maxX.resize(count); maxY.resize(count); maxZ.resize(count);
+	}
+	void Set(size_t i, const glm::vec3& lo, const glm::vec3& hi)
+	{
+		minX[i] = lo.x; minY[i] = lo.y; minZ[i] = lo.z;
+		maxX[i] = hi.x; maxY[i] = hi.y; maxZ[i] = hi.z;
+	}
+};
+
+// Left, right, bottom, top, near, far planes (Gribb & Hartmann) as (n, d) with dot(n, p) + d >= 0
+// inside. Planes are in the space the matrix transforms from, so Projection * View * Model
+// gives model-space planes. Not normalized.
+void ExtractFrustumPlanes(const glm::mat4& mvp, glm::vec4 planes[6]);
+
+// Conservative box test: false only when the box is fully outside one plane
+inline bool AabbInFrustum(const glm::vec4 planes[6], const glm::vec3& lo, const glm::vec3& hi)
+{
+	for (int p = 0; p < 6; p++) {
+		// corner furthest along the plane normal
+		float x = planes[p].x >= 0.0f ? hi.x : lo.x;
+		float y = planes[p].y >= 0.0f ? hi.y : lo.y;
+		float z = planes[p].z >= 0.0f ? hi.z : lo.z;
+		if (planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+// Writes the indices of the chunks that intersect the frustum, in ascending order
+void CullChunks(const glm::vec4 planes[6], const ChunkBounds& bounds, std::vector<unsigned int>& visible);
+
+// Bounds of every patch, in the same space as the TerrainMeshBuilder vertices
+void ComputePatchBounds(const Heightfield& heights, const TerrainPatchSet& patches,
+	float spacing, float heightScale, ChunkBounds& out, int threadCount = 0);
+
+#endif
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "terrain_geomip.hpp"
+#include "trace.hpp"
+
+// Edge mask bits: which neighbour is one level coarser
+enum {
+	EDGE_TOP = 1,     // row - 1
+	EDGE_RIGHT = 2,   // col + 1
+	EDGE_BOTTOM = 4,  // row + 1
+	EDGE_LEFT = 8     // col - 1
+};
+
+GeomipTerrain::GeomipTerrain()
+	: patchSize(0), levels(0), patchRows(0), patchCols(0), spacing(1.0f), maxPixelError(2.0f),
+	indexBuffer(0), trianglesSelected(0)
+{
+}
+
+GeomipTerrain::~GeomipTerrain()
+{
+	if (indexBuffer)
+		glDeleteBuffers(1, &indexBuffer);
+}
+
+// Height of a heightfield vertex, clamped at the border like the vertex shader does
+static float ClampedHeight(const Heightfield& heights, int row, int col, float heightScale)
+{
+	row = row < heights.height ? row : heights.height - 1;
+	col = col < heights.width ? col : heights.width - 1;
+	return heights.Sample(row, col) * heightScale;
+}
+
+bool GeomipTerrain::Init(const Heightfield& heights, int patchSize, float spacing, float heightScale)
+{
+	TRACE_SCOPE("GeomipTerrain::Init");
+	int quads = patchSize - 1;
+	// Patch-local 16-bit indices: 257^2 vertices would already wrap
+	if (patchSize < 9 || patchSize > 129 || (quads & (quads - 1)) != 0) {
+		printf("Geomipmapping: patch size %d is not 2^k + 1 (9..129)\n", patchSize);
+		return false;
+	}
+	this->patchSize = patchSize;
+	this->spacing = spacing;
+	levels = 1;
+	while ((1 << (levels - 1)) < quads)
+		levels++;
+	patchRows = (heights.height - 2) / quads + 1;
+	patchCols = (heights.width - 2) / quads + 1;
+
+	const int patchCount = patchRows * patchCols;
+	levelError.assign((size_t)patchCount * levels, 0.0f);
+	minY.resize(patchCount);
+	maxY.resize(patchCount);
+	level.assign(patchCount, 0);
+
+	// Per patch: height bounds and, per level, the largest difference between a full
+	// resolution vertex and the level's triangulation at that point
+	const int levelCount = levels;
+	ParallelFor(0, patchCount, 0, [&, quads, levelCount, heightScale](int patchBegin, int patchEnd) {
+		std::vector<float> h((size_t)patchSize * patchSize);
+		for (int p = patchBegin; p < patchEnd; p++) {
+			int row0 = (p / patchCols) * quads;
+			int col0 = (p % patchCols) * quads;
+			float lo = 1e30f, hi = -1e30f;
+			for (int r = 0; r < patchSize; r++) {
+				for (int c = 0; c < patchSize; c++) {
+					float y = ClampedHeight(heights, row0 + r, col0 + c, heightScale);
+					h[r * patchSize + c] = y;
+					lo = y < lo ? y : lo;
+					hi = y > hi ? y : hi;
+				}
+			}
+			minY[p] = lo;
+			maxY[p] = hi;
+
+			float* err = &levelError[(size_t)p * levelCount];
+			for (int l = 1; l < levelCount; l++) {
+				const int s = 1 << l;
+				const int cells = quads / s;
+				float e = err[l - 1];
+				for (int r = 0; r < patchSize; r++) {
+					int R = r / s < cells ? r / s : cells - 1;
+					float fr = (r - R * s) / (float)s;
+					for (int c = 0; c < patchSize; c++) {
+						int C = c / s < cells ? c / s : cells - 1;
+						float fc = (c - C * s) / (float)s;
+						float h00 = h[(R * s) * patchSize + C * s];
+						float h01 = h[(R * s) * patchSize + (C + 1) * s];
+						float h10 = h[((R + 1) * s) * patchSize + C * s];
+						float h11 = h[((R + 1) * s) * patchSize + (C + 1) * s];
+						// cells are split along the (R,C)-(R+1,C+1) diagonal
+						float interp = fc >= fr ? h00 + fc * (h01 - h00) + fr * (h11 - h01)
+							: h00 + fr * (h10 - h00) + fc * (h11 - h10);
+						float d = fabsf(h[r * patchSize + c] - interp);
+						e = d > e ? d : e;
+					}
+				}
+				err[l] = e;
+			}
+		}
+	});
+
+	std::vector<GLushort> indices;
+	BuildIndices(indices);
+	if (!indexBuffer)
+		glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+	return true;
+}
+
+void GeomipTerrain::BuildIndices(std::vector<GLushort>& indices)
+{
+	const int quads = patchSize - 1;
+	variants.resize((size_t)levels * 16);
+	indices.clear();
+	std::vector<int> remap((size_t)patchSize * patchSize);
+	for (int l = 0; l < levels; l++) {
+		const int s = 1 << l;
+		for (int variant = 0; variant < 16; variant++) {
+			// The coarsest level never has a coarser neighbour
+			const int mask = l + 1 < levels ? variant : 0;
+			// Odd vertices (at step s) of a stitched edge collapse onto the previous even one,
+			// leaving exactly the vertices of the coarser neighbour's edge
+			for (int r = 0; r < patchSize; r += s) {
+				for (int c = 0; c < patchSize; c += s) {
+					int rr = r, cc = c;
+					bool oddR = (r / s) & 1, oddC = (c / s) & 1;
+					if (oddC && (((mask & EDGE_TOP) && r == 0) || ((mask & EDGE_BOTTOM) && r == quads)))
+						cc = c - s;
+					if (oddR && (((mask & EDGE_LEFT) && c == 0) || ((mask & EDGE_RIGHT) && c == quads)))
+						rr = r - s;
+					remap[r * patchSize + c] = rr * patchSize + cc;
+				}
+			}
+
+			Variant& v = variants[l * 16 + variant];
+			v.firstIndex = indices.size();
+			for (int r = 0; r < quads; r += s) {
+				for (int c = 0; c < quads; c += s) {
+					int v0 = remap[r * patchSize + c];
+					int v1 = remap[r * patchSize + c + s];
+					int v2 = remap[(r + s) * patchSize + c + s];
+					int v3 = remap[(r + s) * patchSize + c];
+					// same winding as the full resolution grid, collapsed triangles dropped
+					if (v0 != v1 && v1 != v2 && v0 != v2) {
+						indices.push_back((GLushort)v0); indices.push_back((GLushort)v1); indices.push_back((GLushort)v2);
+					}
+					if (v0 != v2 && v2 != v3 && v0 != v3) {
+						indices.push_back((GLushort)v0); indices.push_back((GLushort)v2); indices.push_back((GLushort)v3);
+					}
+				}
+			}
+			v.indexCount = (GLsizei)(indices.size() - v.firstIndex);
+		}
+	}
+}
+
+void GeomipTerrain::Select(const glm::vec3& camera, float viewportHeight, float fovY)
+{
+	const int quads = patchSize - 1;
+	const float patchExtent = quads * spacing;
+	// pixels per world unit at distance 1
+	const float K = viewportHeight / (2.0f * tanf(fovY * 0.5f));
+
+	for (int pr = 0; pr < patchRows; pr++) {
+		for (int pc = 0; pc < patchCols; pc++) {
+			int p = pr * patchCols + pc;
+			// distance from the camera to the patch bounds (x = row, z = col)
+			float x0 = pr * patchExtent, z0 = pc * patchExtent;
+			float dx = camera.x < x0 ? x0 - camera.x : (camera.x > x0 + patchExtent ? camera.x - x0 - patchExtent : 0.0f);
+			float dy = camera.y < minY[p] ? minY[p] - camera.y : (camera.y > maxY[p] ? camera.y - maxY[p] : 0.0f);
+			float dz = camera.z < z0 ? z0 - camera.z : (camera.z > z0 + patchExtent ? camera.z - z0 - patchExtent : 0.0f);
+			float d = sqrtf(dx * dx + dy * dy + dz * dz);
+			d = d > 1e-3f ? d : 1e-3f;
+
+			const float* err = &levelError[(size_t)p * levels];
+			int l = 0;
+			while (l + 1 < levels && err[l + 1] * K / d <= maxPixelError)
+				l++;
+			level[p] = (unsigned char)l;
+		}
+	}
+
+	// Neighbours may differ by at most one level; only ever refine to get there
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int pr = 0; pr < patchRows; pr++) {
+			for (int pc = 0; pc < patchCols; pc++) {
+				int p = pr * patchCols + pc;
+				int limit = level[p];
+				if (pr > 0 && level[p - patchCols] + 1 < limit) limit = level[p - patchCols] + 1;
+				if (pr + 1 < patchRows && level[p + patchCols] + 1 < limit) limit = level[p + patchCols] + 1;
+				if (pc > 0 && level[p - 1] + 1 < limit) limit = level[p - 1] + 1;
+				if (pc + 1 < patchCols && level[p + 1] + 1 < limit) limit = level[p + 1] + 1;
+				if (limit < level[p]) {
+					level[p] = (unsigned char)limit;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	trianglesSelected = 0;
+	for (int pr = 0; pr < patchRows; pr++)
+		for (int pc = 0; pc < patchCols; pc++)
+			trianglesSelected += variants[level[pr * patchCols + pc] * 16 + EdgeMask(pr, pc)].indexCount / 3;
+}
+
+int GeomipTerrain::EdgeMask(int pr, int pc) const
+{
+	int p = pr * patchCols + pc;
+	int l = level[p];
+	int mask = 0;
+	if (pr > 0 && level[p - patchCols] > l) mask |= EDGE_TOP;
+	if (pc + 1 < patchCols && level[p + 1] > l) mask |= EDGE_RIGHT;
+	if (pr + 1 < patchRows && level[p + patchCols] > l) mask |= EDGE_BOTTOM;
+	if (pc > 0 && level[p - 1] > l) mask |= EDGE_LEFT;
+	return mask;
+}
+
+void GeomipTerrain::Draw(GLint gridOriginLocation) const
+{
+	const int quads = patchSize - 1;
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	for (int pr = 0; pr < patchRows; pr++) {
+		for (int pc = 0; pc < patchCols; pc++) {
+			const Variant& v = variants[level[pr * patchCols + pc] * 16 + EdgeMask(pr, pc)];
+			glUniform2i(gridOriginLocation, pc * quads, pr * quads);
+			glDrawElements(GL_TRIANGLES, v.indexCount, GL_UNSIGNED_SHORT, (void*)(v.firstIndex * sizeof(GLushort)));
+		}
+	}
+}
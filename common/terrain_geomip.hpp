@@ -0,0 +1,63 @@
+#ifndef TERRAIN_GEOMIP_HPP
+#define TERRAIN_GEOMIP_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+
+// Geomipmapping: the heightfield is split into square patches of patchSize = 2^k + 1 vertices.
+// Every patch picks a level l (vertex step 2^l) from its screen-space error each frame.
+// One shared 16-bit index buffer holds every level in 16 variants, one per combination of
+// edges that border a coarser neighbour; those edges drop their odd vertices so no cracks open.
+//
+// Patches are drawn with shader/heightmap_vertexshader.glsl: indices are patch-local vertex
+// ids (row * patchSize + col) and the patch origin goes into the gridOrigin uniform.
+class GeomipTerrain {
+public:
+	GeomipTerrain();
+	~GeomipTerrain();
+
+	// Precomputes per-patch bounds and per-level errors, creates the index buffer.
+	// patchSize must be 2^k + 1 (9..129), so patch-local indices fit in 16 bits.
+	bool Init(const Heightfield& heights, int patchSize, float spacing, float heightScale);
+
+	// Largest allowed projected error in pixels
+	void SetMaxPixelError(float pixels) { maxPixelError = pixels; }
+
+	// Picks the level of every patch. camera is in model space, fovY in radians.
+	void Select(const glm::vec3& camera, float viewportHeight, float fovY);
+
+	// Issues one glDrawElements per patch. The heightmap program must be bound with
+	// gridCols = GetPatchSize() and vertexBase = 0.
+	void Draw(GLint gridOriginLocation) const;
+
+	int GetPatchSize() const { return patchSize; }
+	int GetLevelCount() const { return levels; }
+	int GetPatchCount() const { return patchRows * patchCols; }
+	size_t GetTriangleCount() const { return trianglesSelected; }
+
+private:
+	struct Variant {
+		size_t firstIndex;
+		GLsizei indexCount;
+	};
+
+	int patchSize;
+	int levels;                       // level l has vertex step 2^l, l = 0 .. levels-1
+	int patchRows, patchCols;
+	float spacing;
+	float maxPixelError;
+	std::vector<float> levelError;    // [patch * levels + l], world-space height error, monotonic in l
+	std::vector<float> minY, maxY;    // per patch
+	std::vector<unsigned char> level; // per patch, last selection
+	std::vector<Variant> variants;    // [l * 16 + edge mask]
+	GLuint indexBuffer;
+	size_t trianglesSelected;
+
+	void BuildIndices(std::vector<GLushort>& indices);
+	int EdgeMask(int patchRow, int patchCol) const;
+};
+
+#endif
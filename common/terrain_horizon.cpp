@@ -0,0 +1,129 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "terrain_cull.hpp"
+#include "terrain_horizon.hpp"
+
+// Monotonic in atan2(dz, dx) over [0, 4), cheaper than atan2. Opposite directions are 2 apart.
+static float PseudoAngle(float dx, float dz)
+{
+	float p = dx / (fabsf(dx) + fabsf(dz));
+	return dz < 0.0f ? 3.0f + p : 1.0f - p;
+}
+
+HorizonCuller::HorizonCuller(int bins)
+	: bins(bins < 16 ? 16 : bins), occluderDistance(1e30f), tested(0), rejected(0)
+{
+}
+
+void HorizonCuller::BuildOccluders(const Heightfield& heights, int cellSize, float spacing, float heightScale)
+{
+	TerrainPatchSet cells;
+	BuildGridPatches(heights.width, heights.height, cellSize + 1, cells);
+	ComputePatchBounds(heights, cells, spacing, heightScale, occluders);
+}
+
+bool HorizonCuller::Footprint(const glm::vec3& camera, float x0, float z0, float x1, float z1,
+	float& binBegin, float& binEnd, float& nearest, float& farthest) const
+{
+	float dx = camera.x < x0 ? x0 - camera.x : (camera.x > x1 ? camera.x - x1 : 0.0f);
+	float dz = camera.z < z0 ? z0 - camera.z : (camera.z > z1 ? camera.z - z1 : 0.0f);
+	nearest = sqrtf(dx * dx + dz * dz);
+	if (nearest <= 0.0f)
+		return false;
+	float fx = fabsf(camera.x - x0) > fabsf(camera.x - x1) ? x0 - camera.x : x1 - camera.x;
+	float fz = fabsf(camera.z - z0) > fabsf(camera.z - z1) ? z0 - camera.z : z1 - camera.z;
+	farthest = sqrtf(fx * fx + fz * fz);
+
+	// The footprint spans less than half a turn, so corner offsets from the centre direction are in (-2, 2)
+	float center = PseudoAngle((x0 + x1) * 0.5f - camera.x, (z0 + z1) * 0.5f - camera.z);
+	float lo = 0.0f, hi = 0.0f;
+	const float cx[4] = { x0, x1, x1, x0 }, cz[4] = { z0, z0, z1, z1 };
+	for (int i = 0; i < 4; i++) {
+		float d = PseudoAngle(cx[i] - camera.x, cz[i] - camera.z) - center;
+		d = d >= 2.0f ? d - 4.0f : (d < -2.0f ? d + 4.0f : d);
+		lo = d < lo ? d : lo;
+		hi = d > hi ? d : hi;
+	}
+	binBegin = (center + lo) * bins * 0.25f;
+	binEnd = (center + hi) * bins * 0.25f;
+	return true;
+}
+
+void HorizonCuller::Cull(const glm::vec3& camera, const ChunkBounds& bounds,
+	const std::vector<unsigned int>& candidates, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	horizon.assign(bins, -1e30f);
+	tested = candidates.size();
+	rejected = 0;
+
+	// Front to back: chunks by nearest distance, occluders by farthest, so an occluder is
+	// rasterised once every chunk it could hide is behind all of it
+	chunkOrder.resize(candidates.size());
+	occluderOrder.clear();
+	for (size_t i = 0; i < candidates.size(); i++) {
+		unsigned int c = candidates[i];
+		float dx = camera.x < bounds.minX[c] ? bounds.minX[c] - camera.x : (camera.x > bounds.maxX[c] ? camera.x - bounds.maxX[c] : 0.0f);
+		float dz = camera.z < bounds.minZ[c] ? bounds.minZ[c] - camera.z : (camera.z > bounds.maxZ[c] ? camera.z - bounds.maxZ[c] : 0.0f);
+		chunkOrder[i].key = dx * dx + dz * dz;
+		chunkOrder[i].index = c;
+		chunkOrder[i].chunk = true;
+		float fx = fabsf(camera.x - bounds.minX[c]) > fabsf(camera.x - bounds.maxX[c]) ? bounds.minX[c] : bounds.maxX[c];
+		float fz = fabsf(camera.z - bounds.minZ[c]) > fabsf(camera.z - bounds.maxZ[c]) ? bounds.minZ[c] : bounds.maxZ[c];
+		Ordered o = { (fx - camera.x) * (fx - camera.x) + (fz - camera.z) * (fz - camera.z), c, true };
+		if (o.key > occluderDistance * occluderDistance)
+			occluderOrder.push_back(o);
+	}
+	std::sort(chunkOrder.begin(), chunkOrder.end());
+	for (size_t i = 0; i < occluders.Count(); i++) {
+		float fx = fabsf(camera.x - occluders.minX[i]) > fabsf(camera.x - occluders.maxX[i]) ? occluders.minX[i] : occluders.maxX[i];
+		float fz = fabsf(camera.z - occluders.minZ[i]) > fabsf(camera.z - occluders.maxZ[i]) ? occluders.minZ[i] : occluders.maxZ[i];
+		Ordered o = { (fx - camera.x) * (fx - camera.x) + (fz - camera.z) * (fz - camera.z), (unsigned int)i, false };
+		if (o.key <= occluderDistance * occluderDistance)
+			occluderOrder.push_back(o);
+	}
+	std::sort(occluderOrder.begin(), occluderOrder.end());
+
+	size_t nextOccluder = 0;
+	for (size_t i = 0; i < chunkOrder.size(); i++) {
+		const unsigned int c = chunkOrder[i].index;
+		while (nextOccluder < occluderOrder.size() && occluderOrder[nextOccluder].key <= chunkOrder[i].key) {
+			const Ordered& next = occluderOrder[nextOccluder++];
+			const ChunkBounds& cells = next.chunk ? bounds : occluders;
+			const unsigned int o = next.index;
+			float b0, b1, nearest, farthest;
+			if (!Footprint(camera, cells.minX[o], cells.minZ[o], cells.maxX[o], cells.maxZ[o], b0, b1, nearest, farthest))
+				continue;
+			// Lowest slope at which the ground under the cell is hit, over bins the cell fully covers
+			float dy = cells.minY[o] - camera.y;
+			float slope = dy / (dy < 0.0f ? nearest : farthest);
+			for (int b = (int)ceilf(b0); b + 1 <= (int)floorf(b1); b++) {
+				float& h = horizon[((b % bins) + bins) % bins];
+				h = slope > h ? slope : h;
+			}
+		}
+
+		float b0, b1, nearest, farthest;
+		if (!Footprint(camera, bounds.minX[c], bounds.minZ[c], bounds.maxX[c], bounds.maxZ[c], b0, b1, nearest, farthest)) {
+			visible.push_back(c);
+			continue;
+		}
+		// Steepest slope any point of the chunk can reach, over every bin it touches
+		float dy = bounds.maxY[c] - camera.y;
+		float slope = dy / (dy >= 0.0f ? nearest : farthest);
+		bool hidden = true;
+		int first = (int)floorf(b0), last = (int)ceilf(b1);
+		last = last > first ? last : first + 1;
+		for (int b = first; b < last && hidden; b++)
+			hidden = horizon[((b % bins) + bins) % bins] > slope;
+		if (hidden)
+			rejected++;
+		else
+			visible.push_back(c);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef TERRAIN_HORIZON_HPP
+#define TERRAIN_HORIZON_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "terrain_cull.hpp"
+
+// CPU horizon occlusion culling for terrain viewed from above the ground.
+// The horizon is a 1D buffer over the azimuth around the camera holding, per direction, the
+// largest slope (dy / horizontal distance) known to be hidden. Everything below a cell's minimum
+// height is solid ground, so small occluder cells are rasterised front to back with their min
+// height, and a chunk is rejected when the steepest slope its max height can reach is under the
+// horizon in every direction it covers. Both bounds are conservative, so nothing visible is culled.
+// Beyond the occluder distance the chunks themselves serve as (coarser) occluders.
+// The buffer is independent of the view direction: only the camera position matters.
+class HorizonCuller {
+public:
+	explicit HorizonCuller(int bins = 2048);
+
+	// Occluder cells of cellSize x cellSize quads with their min height
+	void BuildOccluders(const Heightfield& heights, int cellSize, float spacing, float heightScale);
+
+	// Fine occluder cells are only used up to this horizontal distance from the camera
+	void SetOccluderDistance(float distance) { occluderDistance = distance; }
+
+	// Keeps the candidates (indices into bounds, e.g. CullChunks output) that the horizon doesn't hide.
+	// camera in model space. visible comes out front to back and must not alias candidates.
+	void Cull(const glm::vec3& camera, const ChunkBounds& bounds,
+		const std::vector<unsigned int>& candidates, std::vector<unsigned int>& visible);
+
+	size_t GetTested() const { return tested; }
+	size_t GetRejected() const { return rejected; }
+	float GetRejectedPercent() const { return tested ? 100.0f * rejected / tested : 0.0f; }
+
+private:
+	struct Ordered {
+		float key;
+		unsigned int index;
+		bool chunk;                   // occluder taken from the chunk bounds
+		bool operator<(const Ordered& o) const { return key < o.key; }
+	};
+
+	int bins;
+	float occluderDistance;
+	std::vector<float> horizon;       // per azimuth bin
+	ChunkBounds occluders;
+	std::vector<Ordered> chunkOrder, occluderOrder;
+	size_t tested, rejected;
+
+	// Azimuth range of the footprint in bins, distance range to it. False if the camera is above it.
+	bool Footprint(const glm::vec3& camera, float x0, float z0, float x1, float z1,
+		float& binBegin, float& binEnd, float& nearest, float& farthest) const;
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "parallel.hpp"
+#include "terrain_index.hpp"
+#include "trace.hpp"
+
+// Two triangles per quad, same winding as the original row-major loop.
+// Writes the quads [colBegin, colEnd) of one row and returns the end of the output.
+template<typename T>
+static T* EmitQuadRow(int width, int row, int colBegin, int colEnd, T* dst)
+{
+	for (int col = colBegin; col < colEnd; col++) {
+		T v0 = (T)(row * width + col);
+		T v1 = (T)(row * width + col + 1);
+		T v2 = (T)((row + 1) * width + col + 1);
+		T v3 = (T)((row + 1) * width + col);
+		// upper triangle
+		*dst++ = v0; *dst++ = v1; *dst++ = v2;
+		// lower triangle
+		*dst++ = v0; *dst++ = v2; *dst++ = v3;
+	}
+	return dst;
+}
+
+// The same quads as one triangle strip followed by the restart index. Starting on the
+// lower row gives (v3, v0, v2), (v0, v2, v1) per quad: same winding and diagonal as the list.
+template<typename T>
+static T* EmitStripRow(int width, int row, int colBegin, int colEnd, T* dst)
+{
+	for (int col = colBegin; col <= colEnd; col++) {
+		*dst++ = (T)((row + 1) * width + col);
+		*dst++ = (T)(row * width + col);
+	}
+	*dst++ = (T)~(T)0;
+	return dst;
+}
+
+static int StripQuads(GRID_PRIMITIVE primitive)
+{
+	return primitive == GRID_PRIMITIVE::STRIPS ? GRID_STRIP_QUADS_STRIPS : GRID_STRIP_QUADS;
+}
+
+static size_t RowIndexCount(int quads, GRID_PRIMITIVE primitive)
+{
+	return primitive == GRID_PRIMITIVE::STRIPS ? (size_t)(quads + 1) * 2 + 1 : (size_t)quads * 6;
+}
+
+template<typename T>
+static T* EmitRow(int width, int row, int colBegin, int colEnd, GRID_PRIMITIVE primitive, T* dst)
+{
+	if (primitive == GRID_PRIMITIVE::STRIPS)
+		return EmitStripRow(width, row, colBegin, colEnd, dst);
+	return EmitQuadRow(width, row, colBegin, colEnd, dst);
+}
+
+// Writes rows [rowBegin, rowEnd) starting at dst
+template<typename T>
+static void EmitGridRows(int width, int rowBegin, int rowEnd, GRID_PRIMITIVE primitive, T* dst)
+{
+	for (int row = rowBegin; row < rowEnd; row++)
+		dst = EmitRow(width, row, 0, width - 1, primitive, dst);
+}
+
+// Same quads, in strips of StripQuads() columns: writes strips [stripBegin, stripEnd)
+// of a grid with rows vertex rows, starting at dst
+template<typename T>
+static void EmitGridStrips(int width, int rows, int stripBegin, int stripEnd, GRID_PRIMITIVE primitive, T* dst)
+{
+	const int quads = StripQuads(primitive);
+	for (int strip = stripBegin; strip < stripEnd; strip++) {
+		const int colBegin = strip * quads;
+		const int colEnd = colBegin + quads < width - 1 ? colBegin + quads : width - 1;
+		for (int row = 0; row < rows - 1; row++)
+			dst = EmitRow(width, row, colBegin, colEnd, primitive, dst);
+	}
+}
+
+static size_t GridIndexCount(int width, int height, GRID_ORDER order, GRID_PRIMITIVE primitive)
+{
+	if (order == GRID_ORDER::COLUMN_STRIPS) {
+		const int quads = StripQuads(primitive);
+		const int strips = (width - 2) / quads + 1;
+		const int lastQuads = width - 1 - (strips - 1) * quads;
+		return (size_t)(height - 1) * ((strips - 1) * RowIndexCount(quads, primitive) + RowIndexCount(lastQuads, primitive));
+	}
+	return (size_t)(height - 1) * RowIndexCount(width - 1, primitive);
+}
+
+template<typename T>
+static void EmitGrid(int width, int height, int threadCount, GRID_ORDER order, GRID_PRIMITIVE primitive, T* dst)
+{
+	if (order == GRID_ORDER::COLUMN_STRIPS) {
+		// Strips are contiguous in the output: strip s starts after s full-width strips
+		const int quads = StripQuads(primitive);
+		const size_t indicesPerStrip = (size_t)(height - 1) * RowIndexCount(quads, primitive);
+		const int strips = (width - 2) / quads + 1;
+		ParallelFor(0, strips, threadCount, [=](int stripBegin, int stripEnd) {
+			EmitGridStrips(width, height, stripBegin, stripEnd, primitive, dst + stripBegin * indicesPerStrip);
+		});
+	}
+	else {
+		const size_t indicesPerRow = RowIndexCount(width - 1, primitive);
+		ParallelFor(0, height - 1, threadCount, [=](int rowBegin, int rowEnd) {
+			EmitGridRows(width, rowBegin, rowEnd, primitive, dst + rowBegin * indicesPerRow);
+		});
+	}
+}
+
+void BuildGridIndices(int width, int height, TerrainIndexBuffer& out, int threadCount, GRID_ORDER order, GRID_PRIMITIVE primitive)
+{
+	TRACE_SCOPE("BuildGridIndices");
+	out.mode = primitive == GRID_PRIMITIVE::STRIPS ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+	if (width < 2 || height < 2) {
+		out.type = GL_UNSIGNED_SHORT;
+		out.indices16.clear();
+		out.indices32.clear();
+		return;
+	}
+
+	size_t vertexCount = (size_t)width * height;
+	size_t indexCount = GridIndexCount(width, height, order, primitive);
+	size_t max16 = primitive == GRID_PRIMITIVE::STRIPS ? MAX_16BIT_STRIP_VERTICES : MAX_16BIT_VERTICES;
+	// Every index is overwritten: resizing to the previous count (a rebuild in another order) costs nothing,
+	// clearing first would zero-fill the whole buffer on this thread before the parallel fill
+	if (vertexCount <= max16) {
+		out.type = GL_UNSIGNED_SHORT;
+		out.indices32.clear();
+		out.indices16.resize(indexCount);
+		EmitGrid(width, height, threadCount, order, primitive, &out.indices16[0]);
+	}
+	else {
+		out.type = GL_UNSIGNED_INT;
+		out.indices16.clear();
+		out.indices32.resize(indexCount);
+		EmitGrid(width, height, threadCount, order, primitive, &out.indices32[0]);
+	}
+}
+
+void BuildGridPatches(int width, int height, int patchSize, TerrainPatchSet& out, GRID_ORDER order, GRID_PRIMITIVE primitive)
+{
+	TRACE_SCOPE("BuildGridPatches");
+	out.patches.clear();
+	out.mode = primitive == GRID_PRIMITIVE::STRIPS ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+	out.vertexCount = 0;
+	if (width < 2 || height < 2) {
+		out.indices.clear();
+		return;
+	}
+	// 256 x 256 vertices would make the last vertex collide with the restart index
+	const int maxPatchSize = primitive == GRID_PRIMITIVE::STRIPS ? 255 : 256;
+	if (patchSize > maxPatchSize) patchSize = maxPatchSize;
+	if (patchSize < 2) patchSize = 2;
+
+	// Patches overlap by one vertex so that no quad is lost between them
+	const int step = patchSize - 1;
+	size_t indexCount = 0;
+	for (int row = 0; row < height - 1; row += step) {
+		for (int col = 0; col < width - 1; col += step) {
+			TerrainPatch patch;
+			patch.row = row;
+			patch.col = col;
+			patch.rows = (height - row < patchSize) ? height - row : patchSize;
+			patch.cols = (width - col < patchSize) ? width - col : patchSize;
+			patch.baseVertex = (GLint)out.vertexCount;
+			patch.firstIndex = indexCount;
+			patch.indexCount = (GLsizei)GridIndexCount(patch.cols, patch.rows, order, primitive);
+			out.vertexCount += (size_t)patch.rows * patch.cols;
+			indexCount += patch.indexCount;
+			out.patches.push_back(patch);
+		}
+	}
+
+	// Not cleared first, see BuildGridIndices
+	out.indices.resize(indexCount);
+	for (size_t p = 0; p < out.patches.size(); p++) {
+		const TerrainPatch& patch = out.patches[p];
+		EmitGrid(patch.cols, patch.rows, 1, order, primitive, &out.indices[patch.firstIndex]);
+	}
+}
+
+template<typename T>
+static VertexCacheStats SimulateFifo(const T* indices, size_t count, size_t vertexCount, int cacheSize, GLenum mode,
+	std::vector<size_t>& insertedAt, size_t& misses, size_t& uniqueVertices, size_t& triangles)
+{
+	// A vertex is cached while fewer than cacheSize misses happened since it was inserted
+	size_t stripLength = 0;
+	for (size_t i = 0; i < count; i++) {
+		size_t v = indices[i];
+		if (v >= vertexCount) {
+			stripLength = 0;
+			continue;
+		}
+		// Every strip vertex after the second one completes a triangle
+		if (mode == GL_TRIANGLE_STRIP && ++stripLength >= 3)
+			triangles++;
+		if (insertedAt[v] == 0)
+			uniqueVertices++;
+		if (insertedAt[v] == 0 || misses - insertedAt[v] >= (size_t)cacheSize) {
+			misses++;
+			insertedAt[v] = misses;   // 1-based, 0 means never seen
+		}
+	}
+	if (mode != GL_TRIANGLE_STRIP)
+		triangles += count / 3;
+	VertexCacheStats stats;
+	stats.acmr = triangles ? (float)misses / triangles : 0.0f;
+	stats.atvr = uniqueVertices ? (float)misses / uniqueVertices : 0.0f;
+	return stats;
+}
+
+VertexCacheStats AnalyzeVertexCache(const GLushort* indices, size_t count, size_t vertexCount, int cacheSize, GLenum mode)
+{
+	std::vector<size_t> insertedAt(vertexCount, 0);
+	size_t misses = 0, unique = 0, triangles = 0;
+	return SimulateFifo(indices, count, vertexCount, cacheSize, mode, insertedAt, misses, unique, triangles);
+}
+
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, size_t count, size_t vertexCount, int cacheSize, GLenum mode)
+{
+	std::vector<size_t> insertedAt(vertexCount, 0);
+	size_t misses = 0, unique = 0, triangles = 0;
+	return SimulateFifo(indices, count, vertexCount, cacheSize, mode, insertedAt, misses, unique, triangles);
+}
+
+VertexCacheStats AnalyzeVertexCache(const TerrainIndexBuffer& buffer, size_t vertexCount, int cacheSize)
+{
+	if (buffer.type == GL_UNSIGNED_SHORT)
+		return AnalyzeVertexCache(buffer.indices16.data(), buffer.indices16.size(), vertexCount, cacheSize, buffer.mode);
+	return AnalyzeVertexCache(buffer.indices32.data(), buffer.indices32.size(), vertexCount, cacheSize, buffer.mode);
+}
+
+VertexCacheStats AnalyzeVertexCache(const TerrainPatchSet& set, int cacheSize)
+{
+	size_t misses = 0, unique = 0, triangles = 0;
+	std::vector<size_t> insertedAt;
+	for (size_t p = 0; p < set.patches.size(); p++) {
+		const TerrainPatch& patch = set.patches[p];
+		// Patches don't share cache entries: restart with an empty cache
+		insertedAt.assign((size_t)patch.rows * patch.cols, 0);
+		size_t patchMisses = 0, patchUnique = 0;
+		SimulateFifo(&set.indices[patch.firstIndex], (size_t)patch.indexCount, insertedAt.size(), cacheSize, set.mode,
+			insertedAt, patchMisses, patchUnique, triangles);
+		misses += patchMisses;
+		unique += patchUnique;
+	}
+	VertexCacheStats stats;
+	stats.acmr = triangles ? (float)misses / triangles : 0.0f;
+	stats.atvr = unique ? (float)misses / unique : 0.0f;
+	return stats;
+}
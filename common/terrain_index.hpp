@@ -0,0 +1,110 @@
+#ifndef TERRAIN_INDEX_HPP
+#define TERRAIN_INDEX_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+
+// Primitive restart indices: the largest value of each index type
+static const GLushort GRID_RESTART_INDEX16 = 0xFFFF;
+static const GLuint GRID_RESTART_INDEX32 = 0xFFFFFFFF;
+
+// Index buffer for a width x height vertex grid (vertex = row * width + col).
+// 16-bit indices are used when every vertex is addressable with them, 32-bit otherwise.
+struct TerrainIndexBuffer {
+	GLenum type;                      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLenum mode;                      // GL_TRIANGLES or GL_TRIANGLE_STRIP (strips end with RestartIndex())
+	std::vector<GLushort> indices16;
+	std::vector<GLuint> indices32;
+
+	GLuint RestartIndex() const { return type == GL_UNSIGNED_SHORT ? GRID_RESTART_INDEX16 : GRID_RESTART_INDEX32; }
+	size_t Count() const { return type == GL_UNSIGNED_SHORT ? indices16.size() : indices32.size(); }
+	size_t ByteSize() const { return type == GL_UNSIGNED_SHORT ? indices16.size() * sizeof(GLushort) : indices32.size() * sizeof(GLuint); }
+	const void* Data() const { return type == GL_UNSIGNED_SHORT ? (const void*)indices16.data() : (const void*)indices32.data(); }
+};
+
+// One patch of the grid with its own contiguous block of at most 65536 vertices,
+// so it can be drawn with 16-bit indices through glDrawElementsBaseVertex.
+struct TerrainPatch {
+	int row, col;         // first grid vertex covered by the patch
+	int rows, cols;       // vertices per side (neighbouring patches share their border)
+	GLint baseVertex;     // first vertex of the patch in the patch-ordered vertex buffer
+	size_t firstIndex;    // first index of the patch in TerrainPatchSet::indices
+	GLsizei indexCount;
+};
+
+struct TerrainPatchSet {
+	std::vector<TerrainPatch> patches;
+	GLenum mode;                      // GL_TRIANGLES or GL_TRIANGLE_STRIP (restart index GRID_RESTART_INDEX16)
+	std::vector<GLushort> indices;    // patch-local indices
+	size_t vertexCount;               // vertices of all patches, border vertices counted once per patch
+};
+
+// Largest vertex count that 16-bit indices can address
+static const size_t MAX_16BIT_VERTICES = 65536;
+// Strips give up the last 16-bit index to the restart index
+static const size_t MAX_16BIT_STRIP_VERTICES = 65535;
+
+// Primitive type of the grid indices
+enum class GRID_PRIMITIVE {
+	TRIANGLES,      // triangle list, 6 indices per quad
+	STRIPS          // one triangle strip per row (per row of a column strip), 2 indices per quad
+	                // plus 3 per row; rows are separated by the primitive restart index
+};
+
+// Order in which the quads of a grid are emitted
+enum class GRID_ORDER {
+	ROWS,           // row after row: a row longer than the post-transform cache misses every vertex twice
+	COLUMN_STRIPS   // vertical strips of GRID_STRIP_QUADS(_STRIPS) columns walked row by row, so the previous
+	                // row of the strip is still cached when the next one is drawn
+};
+
+// Strip width for COLUMN_STRIPS: two rows of 8 vertices fit even a 16-entry FIFO cache.
+// Wider strips only win a few percent on larger caches and fall apart on smaller ones.
+static const int GRID_STRIP_QUADS = 7;
+// GRID_PRIMITIVE::STRIPS misses both rows of the first strip row interleaved, so the shared
+// row has to survive a full strip row plus one vertex: 2 x 7 vertices + 1 still fit in 16 entries.
+static const int GRID_STRIP_QUADS_STRIPS = 6;
+
+// Post-transform cache efficiency of an index list, simulated with a FIFO cache
+struct VertexCacheStats {
+	float acmr;   // average cache miss ratio: vertex shader runs per triangle (0.5 is ideal for grids)
+	float atvr;   // average transform to vertex ratio: vertex shader runs per vertex (1.0 is ideal)
+};
+
+// Builds the index list of the full grid, choosing the index type from the vertex count.
+// Rows (or strips) are split across threadCount threads (<= 0: all cores).
+// Both primitives produce the same triangles with the same winding and diagonals.
+void BuildGridIndices(int width, int height, TerrainIndexBuffer& out, int threadCount = 1,
+	GRID_ORDER order = GRID_ORDER::ROWS, GRID_PRIMITIVE primitive = GRID_PRIMITIVE::TRIANGLES);
+
+// Splits the grid into patches of at most patchSize x patchSize vertices
+// (patchSize <= 256 for triangles, <= 255 for strips)
+void BuildGridPatches(int width, int height, int patchSize, TerrainPatchSet& out,
+	GRID_ORDER order = GRID_ORDER::ROWS, GRID_PRIMITIVE primitive = GRID_PRIMITIVE::TRIANGLES);
+
+// Vertices are counted as the ones the indices reference, up to vertexCount.
+// mode is GL_TRIANGLES or GL_TRIANGLE_STRIP; indices >= vertexCount restart the strip.
+VertexCacheStats AnalyzeVertexCache(const GLushort* indices, size_t count, size_t vertexCount, int cacheSize = 32, GLenum mode = GL_TRIANGLES);
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, size_t count, size_t vertexCount, int cacheSize = 32, GLenum mode = GL_TRIANGLES);
+VertexCacheStats AnalyzeVertexCache(const TerrainIndexBuffer& buffer, size_t vertexCount, int cacheSize = 32);
+// Patch-local indices, every patch starting with an empty cache as its base vertex changes
+VertexCacheStats AnalyzeVertexCache(const TerrainPatchSet& set, int cacheSize = 32);
+
+// Copies row-major grid vertices into the patch-ordered layout expected by BuildGridPatches
+template<typename T>
+void ReorderVerticesToPatches(const std::vector<T>& grid, int width, const TerrainPatchSet& set, std::vector<T>& out)
+{
+	out.resize(set.vertexCount);
+	for (size_t p = 0; p < set.patches.size(); p++) {
+		const TerrainPatch& patch = set.patches[p];
+		T* dst = &out[patch.baseVertex];
+		for (int r = 0; r < patch.rows; r++) {
+			const T* src = &grid[(size_t)(patch.row + r) * width + patch.col];
+			for (int c = 0; c < patch.cols; c++)
+				*dst++ = src[c];
+		}
+	}
+}
+
+#endif
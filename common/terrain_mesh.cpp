@@ -0,0 +1,141 @@
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "parallel.hpp"
+#include "terrain_mesh.hpp"
+#include "trace.hpp"
+
+TerrainMeshBuilder::TerrainMeshBuilder(int threadCount)
+	: threadCount(threadCount), order(GRID_ORDER::ROWS), primitive(GRID_PRIMITIVE::TRIANGLES), spacing(0.1f), heightScale(1.0f)
+{
+}
+
+template<typename T>
+static void FillRows(const T* heights, int width, int rowBegin, int rowEnd, float spacing, float yScale, glm::vec3* dst)
+{
+	for (int row = rowBegin; row < rowEnd; row++) {
+		const T* src = heights + (size_t)row * width;
+		glm::vec3* out = dst + (size_t)row * width;
+		const float x = row * spacing;
+		for (int col = 0; col < width; col++) {
+			out[col].x = x;
+			out[col].y = src[col] * yScale;
+			out[col].z = col * spacing;
+		}
+	}
+}
+
+void TerrainMeshBuilder::BuildVertices(const Heightfield& heights, std::vector<glm::vec3>& vertices) const
+{
+	TRACE_SCOPE("TerrainMeshBuilder::BuildVertices");
+	const int width = heights.width;
+	vertices.resize((size_t)width * heights.height);
+	if (vertices.empty())
+		return;
+
+	glm::vec3* dst = &vertices[0];
+	const float spacing = this->spacing;
+	if (heights.format == HEIGHT_FORMAT::R16) {
+		const unsigned short* src = &heights.r16[0];
+		const float yScale = heightScale / 65535.0f;
+		ParallelFor(0, heights.height, threadCount, [=](int rowBegin, int rowEnd) {
+			FillRows(src, width, rowBegin, rowEnd, spacing, yScale, dst);
+		});
+	}
+	else {
+		const float* src = &heights.r32f[0];
+		const float yScale = heightScale;
+		ParallelFor(0, heights.height, threadCount, [=](int rowBegin, int rowEnd) {
+			FillRows(src, width, rowBegin, rowEnd, spacing, yScale, dst);
+		});
+	}
+}
+
+void TerrainMeshBuilder::BuildIndices(int width, int height, TerrainIndexBuffer& indices) const
+{
+	TRACE_SCOPE("TerrainMeshBuilder::BuildIndices");
+	BuildGridIndices(width, height, indices, threadCount, order, primitive);
+}
+
+// 16-bit height of sample i: R16 as is, R32F over its own min..max range
+struct HeightQuantiser {
+	const Heightfield* heights;
+	float minHeight, scale;
+
+	unsigned short operator()(size_t i) const {
+		if (heights->format == HEIGHT_FORMAT::R16)
+			return heights->r16[i];
+		return (unsigned short)((heights->r32f[i] - minHeight) * scale + 0.5f);
+	}
+};
+
+void TerrainMeshBuilder::BuildPackedVertices(const Heightfield& heights, const TerrainPatchSet& patches, PackedVertexBuffer& vertices) const
+{
+	TRACE_SCOPE("TerrainMeshBuilder::BuildPackedVertices");
+	const int width = heights.width;
+	HeightQuantiser quantise;
+	quantise.heights = &heights;
+	quantise.minHeight = 0.0f;
+	quantise.scale = 1.0f;
+	if (heights.format == HEIGHT_FORMAT::R16) {
+		vertices.heightBase = 0.0f;
+		vertices.heightStep = heightScale / 65535.0f;
+	}
+	else {
+		float lo = 0.0f, hi = 0.0f;
+		if (!heights.r32f.empty()) {
+			lo = hi = heights.r32f[0];
+			for (size_t i = 1; i < heights.r32f.size(); i++) {
+				if (heights.r32f[i] < lo) lo = heights.r32f[i];
+				if (heights.r32f[i] > hi) hi = heights.r32f[i];
+			}
+		}
+		quantise.minHeight = lo;
+		quantise.scale = hi > lo ? 65535.0f / (hi - lo) : 0.0f;
+		vertices.heightBase = lo * heightScale;
+		vertices.heightStep = (hi - lo) / 65535.0f * heightScale;
+	}
+
+	if (!patches.patches.empty()) {
+		vertices.componentType = GL_UNSIGNED_BYTE;
+		vertices.data.resize(patches.vertexCount * 4);
+		unsigned char* dst = &vertices.data[0];
+		const TerrainPatch* patch = &patches.patches[0];
+		ParallelFor(0, (int)patches.patches.size(), threadCount, [=](int patchBegin, int patchEnd) {
+			for (int p = patchBegin; p < patchEnd; p++) {
+				unsigned char* out = dst + (size_t)patch[p].baseVertex * 4;
+				for (int r = 0; r < patch[p].rows; r++) {
+					size_t i = (size_t)(patch[p].row + r) * width + patch[p].col;
+					for (int c = 0; c < patch[p].cols; c++, i++) {
+						unsigned short h = quantise(i);
+						*out++ = (unsigned char)c;
+						*out++ = (unsigned char)r;
+						*out++ = (unsigned char)(h & 255);
+						*out++ = (unsigned char)(h >> 8);
+					}
+				}
+			}
+		});
+	}
+	else {
+		vertices.componentType = GL_UNSIGNED_SHORT;
+		vertices.data.resize((size_t)width * heights.height * 8);
+		if (vertices.data.empty())
+			return;
+		unsigned short* dst = (unsigned short*)&vertices.data[0];
+		ParallelFor(0, heights.height, threadCount, [=](int rowBegin, int rowEnd) {
+			for (int row = rowBegin; row < rowEnd; row++) {
+				unsigned short* out = dst + (size_t)row * width * 4;
+				size_t i = (size_t)row * width;
+				for (int col = 0; col < width; col++, i++) {
+					*out++ = (unsigned short)col;
+					*out++ = (unsigned short)row;
+					*out++ = quantise(i);
+					*out++ = 0;
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef TERRAIN_MESH_HPP
+#define TERRAIN_MESH_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "terrain_index.hpp"
+
+// Quantised terrain vertices for shader/vertexshader.glsl, four components per vertex.
+// With patches: (col, row, height & 255, height >> 8) as bytes relative to the patch origin.
+// Without:      (col, row, height, 0) as shorts relative to the grid.
+// Model space height = heightBase + (x + 256 * y) * heightStep for the last two components.
+struct PackedVertexBuffer {
+	GLenum componentType;             // GL_UNSIGNED_BYTE (4 bytes per vertex) or GL_UNSIGNED_SHORT (8 bytes)
+	std::vector<unsigned char> data;
+	float heightBase;
+	float heightStep;
+
+	size_t VertexSize() const { return componentType == GL_UNSIGNED_BYTE ? 4 : 8; }
+	size_t VertexCount() const { return data.size() / VertexSize(); }
+};
+
+// Turns a heightmap into the terrain vertex and index buffers.
+// Output vectors are sized once up front and filled row by row across threadCount
+// threads, so rebuilding into the same vectors does not reallocate.
+class TerrainMeshBuilder {
+public:
+	explicit TerrainMeshBuilder(int threadCount = 0);  // 0: all cores
+
+	void SetThreadCount(int threadCount) { this->threadCount = threadCount; }
+	int GetThreadCount() const { return threadCount; }
+
+	// Quad order of BuildIndices
+	void SetGridOrder(GRID_ORDER order) { this->order = order; }
+	GRID_ORDER GetGridOrder() const { return order; }
+	// Triangle list or restart-separated strips
+	void SetGridPrimitive(GRID_PRIMITIVE primitive) { this->primitive = primitive; }
+	GRID_PRIMITIVE GetGridPrimitive() const { return primitive; }
+
+	// Grid spacing on X/Z and the factor applied to Heightfield::Sample() for Y
+	void SetScale(float spacing, float heightScale) { this->spacing = spacing; this->heightScale = heightScale; }
+
+	// Vertex (row, col) = (row * spacing, Sample(row, col) * heightScale, col * spacing)
+	void BuildVertices(const Heightfield& heights, std::vector<glm::vec3>& vertices) const;
+	void BuildIndices(int width, int height, TerrainIndexBuffer& indices) const;
+	// Packed vertices in the patch-ordered layout of patches, or row-major if it is empty.
+	// Patches must be at most 256 vertices wide.
+	void BuildPackedVertices(const Heightfield& heights, const TerrainPatchSet& patches, PackedVertexBuffer& vertices) const;
+
+	void Build(const Heightfield& heights, std::vector<glm::vec3>& vertices, TerrainIndexBuffer& indices) const
+	{
+		BuildVertices(heights, vertices);
+		BuildIndices(heights.width, heights.height, indices);
+	}
+
+private:
+	int threadCount;
+	GRID_ORDER order;
+	GRID_PRIMITIVE primitive;
+	float spacing;
+	float heightScale;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "terrain_index.hpp"
+#include "stream_buffer.hpp"
+#include "terrain_multidraw.hpp"
+
+ChunkBatcher::ChunkBatcher()
+	: stride(0), chunkBuffer(0), chunkTexture(0), indirectBuffer(0)
+{
+}
+
+ChunkBatcher::~ChunkBatcher()
+{
+	Shutdown();
+}
+
+bool ChunkBatcher::Init(const TerrainPatchSet& patches, bool createGL)
+{
+	Shutdown();
+	stride = 0;
+	for (size_t p = 0; p < patches.patches.size(); p++) {
+		GLint vertices = (GLint)(patches.patches[p].rows * patches.patches[p].cols);
+		stride = vertices > stride ? vertices : stride;
+	}
+	if (stride > 0 && patches.patches.size() > (size_t)(INT32_MAX / stride)) {
+		printf("ChunkBatcher: %zu chunks of %d vertices overflow gl_VertexID\n", patches.patches.size(), stride);
+		return false;
+	}
+	if (!createGL || patches.patches.empty())
+		return true;
+
+	std::vector<GLint> table(patches.patches.size() * 4);
+	for (size_t p = 0; p < patches.patches.size(); p++) {
+		table[p * 4 + 0] = patches.patches[p].col;
+		table[p * 4 + 1] = patches.patches[p].row;
+		table[p * 4 + 2] = patches.patches[p].cols;
+		table[p * 4 + 3] = patches.patches[p].rows;
+	}
+	glGenBuffers(1, &chunkBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, chunkBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(GLint), &table[0], GL_STATIC_DRAW);
+	glGenTextures(1, &chunkTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, chunkTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, chunkBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	return true;
+}
+
+void ChunkBatcher::Shutdown()
+{
+	if (chunkTexture)
+		glDeleteTextures(1, &chunkTexture);
+	if (chunkBuffer)
+		glDeleteBuffers(1, &chunkBuffer);
+	if (indirectBuffer)
+		glDeleteBuffers(1, &indirectBuffer);
+	chunkTexture = 0;
+	chunkBuffer = 0;
+	indirectBuffer = 0;
+}
+
+bool ChunkBatcher::IndirectSupported()
+{
+	return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+void ChunkBatcher::Build(const TerrainPatchSet& patches, const std::vector<unsigned int>& visible, bool virtualVertices)
+{
+	counts.resize(visible.size());
+	offsets.resize(visible.size());
+	baseVertices.resize(visible.size());
+	commands.resize(visible.size());
+	for (size_t v = 0; v < visible.size(); v++) {
+		const TerrainPatch& patch = patches.patches[visible[v]];
+		const GLint baseVertex = virtualVertices ? (GLint)visible[v] * stride : patch.baseVertex;
+		counts[v] = patch.indexCount;
+		offsets[v] = (const GLvoid*)(patch.firstIndex * sizeof(GLushort));
+		baseVertices[v] = baseVertex;
+		DrawElementsIndirectCommand& command = commands[v];
+		command.count = (GLuint)patch.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = (GLuint)patch.firstIndex;
+		command.baseVertex = baseVertex;
+		command.baseInstance = 0;
+	}
+}
+
+void ChunkBatcher::Submit(CHUNK_SUBMIT mode, GLenum primitive, StreamBuffer* ring)
+{
+	if (counts.empty())
+		return;
+	if (mode != CHUNK_SUBMIT::INDIRECT || !IndirectSupported()) {
+		glMultiDrawElementsBaseVertex(primitive, &counts[0], GL_UNSIGNED_SHORT, &offsets[0], (GLsizei)counts.size(), &baseVertices[0]);
+		return;
+	}
+
+	const size_t bytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+	size_t offset = 0;
+	if (ring && ring->Write(&commands[0], bytes, sizeof(GLuint), offset)) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring->GetBuffer());
+	}
+	else {
+		if (!indirectBuffer)
+			glGenBuffers(1, &indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, bytes, NULL, GL_STREAM_DRAW);   // orphan last frame's commands
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, &commands[0]);
+		offset = 0;
+	}
+	glMultiDrawElementsIndirect(primitive, GL_UNSIGNED_SHORT, (const GLvoid*)offset, (GLsizei)commands.size(), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
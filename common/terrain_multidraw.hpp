@@ -0,0 +1,67 @@
+#ifndef TERRAIN_MULTIDRAW_HPP
+#define TERRAIN_MULTIDRAW_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+
+#include "terrain_index.hpp"
+#include "stream_buffer.hpp"
+
+// How the visible chunks of a TerrainPatchSet reach the GPU
+enum class CHUNK_SUBMIT {
+	PER_CHUNK,      // per-chunk uniforms + glDrawElementsBaseVertex, one call per chunk
+	MULTI_DRAW,     // one glMultiDrawElementsBaseVertex (GL 3.2)
+	INDIRECT        // DrawElementsIndirectCommand buffer + one glMultiDrawElementsIndirect (GL 4.3)
+};
+
+// Layout fixed by GL
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Batches the visible chunks into one multi-draw call.
+//
+// A multi-draw has no per-draw uniforms and GLSL 3.30 has no draw ID, so for chunks without a
+// vertex buffer (vertices from gl_VertexID and a height texture) the base vertex carries it:
+// chunk i is drawn with base vertex i * GetChunkStride(), the shader divides gl_VertexID by the
+// stride and fetches (col, row, cols, rows) of the chunk from GetChunkTexture(), an RGBA32I buffer
+// texture. Chunks that do have a vertex buffer keep their real base vertex and need no table.
+class ChunkBatcher {
+public:
+	ChunkBatcher();
+	~ChunkBatcher();
+
+	// Builds the chunk table; without createGL only Build runs
+	bool Init(const TerrainPatchSet& patches, bool createGL = true);
+	void Shutdown();
+
+	static bool IndirectSupported();
+
+	// Draw arrays and indirect commands of the visible chunks (indices into patches.patches)
+	void Build(const TerrainPatchSet& patches, const std::vector<unsigned int>& visible, bool virtualVertices);
+	// MULTI_DRAW or INDIRECT; the chunk indices must be bound to GL_ELEMENT_ARRAY_BUFFER.
+	// INDIRECT writes the commands into ring when it has room, into an orphaned buffer otherwise.
+	void Submit(CHUNK_SUBMIT mode, GLenum primitive, StreamBuffer* ring = NULL);
+
+	GLuint GetChunkTexture() const { return chunkTexture; }
+	GLint GetChunkStride() const { return stride; }
+	size_t GetDrawCount() const { return counts.size(); }
+	const std::vector<DrawElementsIndirectCommand>& GetCommands() const { return commands; }
+
+private:
+	GLint stride;
+	std::vector<GLsizei> counts;
+	std::vector<const GLvoid*> offsets;
+	std::vector<GLint> baseVertices;
+	std::vector<DrawElementsIndirectCommand> commands;
+	GLuint chunkBuffer;
+	GLuint chunkTexture;
+	GLuint indirectBuffer;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include <math.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "terrain_normals.hpp"
+#include "trace.hpp"
+
+// Gradient (gx, gz) = (dh/dx, dh/dz) to the encoded normal (-gx, 1, -gz) / L1 norm.
+// Same operation order as the SSE2 path, so both round to the same shorts.
+static inline void EncodeNormal(float gx, float gz, short* out)
+{
+	const float inv = -32767.0f / ((fabsf(gx) + fabsf(gz)) + 1.0f);
+	out[0] = (short)lrintf(gx * inv);
+	out[1] = (short)lrintf(gz * inv);
+}
+
+#ifdef TERRAIN_SSE2
+static inline __m128 Load4(const unsigned short* p)
+{
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()));
+}
+
+static inline __m128 Load4(const float* p)
+{
+	return _mm_loadu_ps(p);
+}
+#endif
+
+// Rows [rowBegin, rowEnd). gradientScale turns a sample difference over one grid step into a slope.
+template<typename T>
+static void NormalRows(const T* heights, int width, int height, int rowBegin, int rowEnd, float gradientScale, short* dst)
+{
+	for (int row = rowBegin; row < rowEnd; row++) {
+		const int up = row > 0 ? row - 1 : 0;
+		const int down = row < height - 1 ? row + 1 : height - 1;
+		const T* a = heights + (size_t)up * width;
+		const T* b = heights + (size_t)down * width;
+		const T* m = heights + (size_t)row * width;
+		short* out = dst + (size_t)row * width * 2;
+		const float sx = down > up ? gradientScale / (down - up) : 0.0f;
+		const float sz = gradientScale * 0.5f;
+
+		if (width == 1) {
+			EncodeNormal(((float)b[0] - (float)a[0]) * sx, 0.0f, out);
+			continue;
+		}
+		EncodeNormal(((float)b[0] - (float)a[0]) * sx, ((float)m[1] - (float)m[0]) * gradientScale, out);
+		int col = 1;
+#ifdef TERRAIN_SSE2
+		const __m128 vsx = _mm_set1_ps(sx);
+		const __m128 vsz = _mm_set1_ps(sz);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(-32767.0f);
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (; col + 4 <= width - 1; col += 4) {
+			__m128 gx = _mm_mul_ps(_mm_sub_ps(Load4(b + col), Load4(a + col)), vsx);
+			__m128 gz = _mm_mul_ps(_mm_sub_ps(Load4(m + col + 1), Load4(m + col - 1)), vsz);
+			__m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, gx), _mm_andnot_ps(signMask, gz)), one);
+			__m128 inv = _mm_div_ps(scale, l1);
+			__m128i x = _mm_cvtps_epi32(_mm_mul_ps(gx, inv));
+			__m128i z = _mm_cvtps_epi32(_mm_mul_ps(gz, inv));
+			// x0 z0 x1 z1 x2 z2 x3 z3
+			_mm_storeu_si128((__m128i*)(out + 2 * col), _mm_unpacklo_epi16(_mm_packs_epi32(x, x), _mm_packs_epi32(z, z)));
+		}
+#endif
+		for (; col < width - 1; col++)
+			EncodeNormal(((float)b[col] - (float)a[col]) * sx, ((float)m[col + 1] - (float)m[col - 1]) * sz, out + 2 * col);
+		EncodeNormal(((float)b[width - 1] - (float)a[width - 1]) * sx,
+			((float)m[width - 1] - (float)m[width - 2]) * gradientScale, out + 2 * (width - 1));
+	}
+}
+
+void BuildNormalMap(const Heightfield& heights, float spacing, float heightScale,
+	std::vector<short>& normals, int threadCount)
+{
+	TRACE_SCOPE("BuildNormalMap");
+	const int width = heights.width, height = heights.height;
+	normals.resize((size_t)width * height * 2);
+	if (normals.empty())
+		return;
+
+	short* dst = &normals[0];
+	if (heights.format == HEIGHT_FORMAT::R16) {
+		const unsigned short* src = &heights.r16[0];
+		const float gradientScale = heightScale / (65535.0f * spacing);
+		ParallelFor(0, height, threadCount, [=](int rowBegin, int rowEnd) {
+			NormalRows(src, width, height, rowBegin, rowEnd, gradientScale, dst);
+		});
+	}
+	else {
+		const float* src = &heights.r32f[0];
+		const float gradientScale = heightScale / spacing;
+		ParallelFor(0, height, threadCount, [=](int rowBegin, int rowEnd) {
+			NormalRows(src, width, height, rowBegin, rowEnd, gradientScale, dst);
+		});
+	}
+}
+
+GLuint UploadNormalTexture(const std::vector<short>& normals, int width, int height)
+{
+	TRACE_SCOPE("UploadNormalTexture");
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16_SNORM, width, height, 0, GL_RG, GL_SHORT, normals.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	return textureID;
+}
@@ -0,0 +1,33 @@
+#ifndef TERRAIN_NORMALS_HPP
+#define TERRAIN_NORMALS_HPP
+
+#include <math.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+
+// Per-sample normals of a heightfield from central differences (one-sided on the border),
+// in the same model space as TerrainMeshBuilder: x follows rows, z follows columns, y is up.
+//
+// A terrain normal always points up, so it is stored hemi-octahedral: n / (|n.x| + |n.y| + |n.z|)
+// keeps x and z, y is implied. Two snorm16 components per sample, 4 bytes instead of 12.
+// With the unnormalised normal (-dh/dx, 1, -dh/dz) the encoding needs no square root.
+
+// Writes 2 * width * height shorts, (x, z) per sample, row-major. Rows are split across
+// threadCount threads (<= 0: all cores); SSE2 does 4 samples at a time.
+void BuildNormalMap(const Heightfield& heights, float spacing, float heightScale,
+	std::vector<short>& normals, int threadCount = 0);
+
+// GL_RG16_SNORM texture of the encoded normals (linear filtering, clamped, no mipmaps)
+GLuint UploadNormalTexture(const std::vector<short>& normals, int width, int height);
+
+inline glm::vec3 DecodeNormal(short x, short z)
+{
+	float nx = x * (1.0f / 32767.0f), nz = z * (1.0f / 32767.0f);
+	float ny = 1.0f - fabsf(nx) - fabsf(nz);
+	return glm::normalize(glm::vec3(nx, ny > 0.0f ? ny : 0.0f, nz));
+}
+
+#endif
@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "terrain_index.hpp"
+#include "terrain_tiles.hpp"
+#include "terrain_stream.hpp"
+#include "trace.hpp"
+
+typedef std::chrono::steady_clock StreamClock;
+
+static float MsSince(StreamClock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(StreamClock::now() - start).count();
+}
+
+TileStreamer::TileStreamer()
+	: tileSize(0), topLevel(0), tileBytes(0), spacing(0.1f), heightScale(1.0f), lodRange(2.0f),
+	uploadBytesPerFrame(0), maxInFlight(0), frame(0), texture(0), indexBuffer(0), indexType(GL_UNSIGNED_SHORT),
+	indexCount(0), uploadBuffer(NULL), stopping(false)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+TileStreamer::~TileStreamer()
+{
+	Shutdown();
+}
+
+bool TileStreamer::Init(const char* path, float spacing, float heightScale, int workerCount, size_t cacheBytes,
+	size_t uploadBytesPerFrame, bool createGL)
+{
+	TRACE_SCOPE("TileStreamer::Init");
+	Shutdown();
+	if (!file.Open(path))
+		return false;
+	this->spacing = spacing;
+	this->heightScale = heightScale;
+	this->uploadBytesPerFrame = uploadBytesPerFrame;
+	tileSize = file.GetTileSize();
+	topLevel = file.GetLevelCount() - 1;
+	tileBytes = (size_t)(tileSize + 1) * (tileSize + 1) * (file.GetFormat() == HEIGHT_FORMAT::R16 ? 2 : 4);
+	if (workerCount < 1)
+		workerCount = 1;
+	maxInFlight = (size_t)workerCount * 4 + 8;
+	frame = 0;
+	memset(&stats, 0, sizeof(stats));
+
+	// The coarsest level stays resident, the rest of the slots is the cache
+	const int topTiles = file.GetTilesX(topLevel) * file.GetTilesZ(topLevel);
+	size_t slots = cacheBytes / tileBytes;
+	if (slots < (size_t)topTiles + 16)
+		slots = (size_t)topTiles + 16;
+	if (createGL) {
+		GLint maxLayers = 256;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		if (slots > (size_t)maxLayers)
+			slots = (size_t)maxLayers;
+		if ((size_t)topTiles + 4 > slots) {
+			printf("%s: %d tiles in the coarsest level do not fit in %d texture layers\n", path, topTiles, maxLayers);
+			file.Close();
+			return false;
+		}
+	}
+	stats.slots = slots;
+	freeSlots.clear();
+	for (int s = (int)slots - 1; s >= 0; s--)
+		freeSlots.push_back(s);
+
+	if (createGL) {
+		const int side = tileSize + 1;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		if (file.GetFormat() == HEIGHT_FORMAT::R16)
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, side, side, (GLsizei)slots, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+		else
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, side, side, (GLsizei)slots, 0, GL_RED, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+		TerrainIndexBuffer indices;
+		BuildGridIndices(side, side, indices, 1, GRID_ORDER::COLUMN_STRIPS);
+		indexType = indices.type;
+		indexCount = (GLsizei)indices.Count();
+		glGenBuffers(1, &indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.ByteSize(), indices.Data(), GL_STATIC_DRAW);
+	}
+
+	// Coarsest level up front, on this thread
+	for (int row = 0; row < file.GetTilesZ(topLevel); row++) {
+		for (int col = 0; col < file.GetTilesX(topLevel); col++) {
+			Entry& entry = entries[Key(topLevel, row, col)];
+			entry.lastUsed = entry.wantedFrame = 0;
+			if (!file.ReadTile(topLevel, row, col, entry.data)) {
+				printf("%s: tile %d/%d of level %d is corrupt\n", path, row, col, topLevel);
+				Shutdown();
+				return false;
+			}
+			entry.slot = AllocateSlot();
+			Upload(entry);
+		}
+	}
+
+	stopping = false;
+	for (int w = 0; w < workerCount; w++)
+		workers.push_back(std::thread(&TileStreamer::WorkerLoop, this));
+	return true;
+}
+
+void TileStreamer::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	wake.notify_all();
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+	workers.clear();
+	taken.clear();
+	done.clear();
+	entries.clear();
+	readyOrder.clear();
+	drawList.clear();
+	if (texture)
+		glDeleteTextures(1, &texture);
+	if (indexBuffer)
+		glDeleteBuffers(1, &indexBuffer);
+	texture = 0;
+	indexBuffer = 0;
+	file.Close();
+}
+
+void TileStreamer::WorkerLoop()
+{
+	TRACE_THREAD_NAME("tile reader");
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (stopping)
+			return;
+		Loaded loaded;
+		loaded.key = queue.front();
+		queue.pop_front();
+		taken.push_back(loaded.key);
+		lock.unlock();
+		loaded.ok = file.ReadTile(KeyLevel(loaded.key), KeyRow(loaded.key), KeyCol(loaded.key), loaded.data);
+		lock.lock();
+		done.push_back(std::move(loaded));
+	}
+}
+
+float TileStreamer::Distance(const glm::vec3& camera, int level, int row, int col) const
+{
+	// x follows rows, z follows columns; heights stay below heightScale
+	const float side = (float)(tileSize << level) * spacing;
+	const float x0 = row * side, z0 = col * side;
+	float dx = camera.x < x0 ? x0 - camera.x : (camera.x > x0 + side ? camera.x - x0 - side : 0.0f);
+	float dz = camera.z < z0 ? z0 - camera.z : (camera.z > z0 + side ? camera.z - z0 - side : 0.0f);
+	float dy = camera.y > heightScale ? camera.y - heightScale : (camera.y < 0.0f ? -camera.y : 0.0f);
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+bool TileStreamer::Want(int level, int row, int col, float priority)
+{
+	const uint64_t key = Key(level, row, col);
+	std::unordered_map<uint64_t, Entry>::iterator it = entries.find(key);
+	if (it != entries.end()) {
+		it->second.wantedFrame = frame;
+		if (it->second.state == TILE_RESIDENT) {
+			it->second.lastUsed = frame;
+			stats.hits++;
+			return true;
+		}
+		stats.misses++;
+		if (it->second.state == TILE_QUEUED) {
+			Request request = { key, priority };
+			wanted.push_back(request);
+		}
+		return false;
+	}
+	stats.misses++;
+	Request request = { key, priority };
+	wanted.push_back(request);
+	return false;
+}
+
+void TileStreamer::Select(const glm::vec3& camera, int level, int row, int col)
+{
+	const float side = (float)(tileSize << level) * spacing;
+	if (level > 0 && Distance(camera, level, row, col) < lodRange * side) {
+		// Children cover level - 1 tiles 2row..2row+1 x 2col..2col+1, clipped to the map
+		const int rows = 2 * row + 1 < file.GetTilesZ(level - 1) ? 2 : 1;
+		const int cols = 2 * col + 1 < file.GetTilesX(level - 1) ? 2 : 1;
+		const float childSide = side * 0.5f;
+		bool resident = true;
+		for (int r = 0; r < rows; r++) {
+			for (int c = 0; c < cols; c++) {
+				float priority = Distance(camera, level - 1, 2 * row + r, 2 * col + c) / childSide;
+				resident = Want(level - 1, 2 * row + r, 2 * col + c, priority) && resident;
+			}
+		}
+		if (resident) {
+			for (int r = 0; r < rows; r++)
+				for (int c = 0; c < cols; c++)
+					Select(camera, level - 1, 2 * row + r, 2 * col + c);
+			return;
+		}
+	}
+	DrawTile tile;
+	tile.slot = entries[Key(level, row, col)].slot;
+	tile.originCol = (col * tileSize) << level;
+	tile.originRow = (row * tileSize) << level;
+	tile.step = 1 << level;
+	drawList.push_back(tile);
+}
+
+int TileStreamer::AllocateSlot()
+{
+	if (!freeSlots.empty()) {
+		int slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+	// Least recently used tile that this frame did not visit; the coarsest level is pinned
+	std::unordered_map<uint64_t, Entry>::iterator victim = entries.end();
+	for (std::unordered_map<uint64_t, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+		const Entry& entry = it->second;
+		if (entry.state != TILE_RESIDENT || entry.lastUsed == frame || KeyLevel(it->first) == topLevel)
+			continue;
+		if (victim == entries.end() || entry.lastUsed < victim->second.lastUsed)
+			victim = it;
+	}
+	if (victim == entries.end())
+		return -1;
+	int slot = victim->second.slot;
+	entries.erase(victim);
+	return slot;
+}
+
+void TileStreamer::Upload(Entry& entry)
+{
+	TRACE_SCOPE("TileStreamer::Upload");
+	if (texture) {
+		const int side = tileSize + 1;
+		const GLenum type = entry.data.format == HEIGHT_FORMAT::R16 ? GL_UNSIGNED_SHORT : GL_FLOAT;
+		size_t offset = 0;
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, entry.data.format == HEIGHT_FORMAT::R16 ? 2 : 4);
+		if (uploadBuffer && uploadBuffer->Write(entry.data.Data(), tileBytes, 4, offset)) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer->GetBuffer());
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, entry.slot, side, side, 1, GL_RED, type, (void*)offset);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		else {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, entry.slot, side, side, 1, GL_RED, type, entry.data.Data());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	entry.state = TILE_RESIDENT;
+	entry.data = Heightfield();
+}
+
+void TileStreamer::Update(const glm::vec3& camera)
+{
+	TRACE_SCOPE("TileStreamer::Update");
+	StreamClock::time_point start = StreamClock::now();
+	frame++;
+	wanted.clear();
+	drawList.clear();
+
+	std::vector<Loaded> loaded;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded.swap(done);
+	}
+	for (size_t i = 0; i < loaded.size(); i++) {
+		// Only reads that are still expected: a tile may have been dropped and requested again since
+		std::unordered_map<uint64_t, Entry>::iterator it = entries.find(loaded[i].key);
+		if (it == entries.end() || (it->second.state != TILE_QUEUED && it->second.state != TILE_LOADING))
+			continue;
+		if (!loaded[i].ok) {
+			printf("Tile streaming: tile %d/%d of level %d could not be read\n",
+				KeyRow(loaded[i].key), KeyCol(loaded[i].key), KeyLevel(loaded[i].key));
+			entries.erase(it);
+			continue;
+		}
+		it->second.state = TILE_READY;
+		it->second.data = std::move(loaded[i].data);
+		readyOrder.push_back(loaded[i].key);
+		stats.tilesLoaded++;
+	}
+
+	for (int row = 0; row < file.GetTilesZ(topLevel); row++)
+		for (int col = 0; col < file.GetTilesX(topLevel); col++)
+			Select(camera, topLevel, row, col);
+
+	// Replace the queue with this frame's requests, nearest first. Queued tiles nobody wants
+	// any more are dropped; tiles a worker has taken finish loading either way and are never
+	// queued again (Want still sees a tile taken since the last Update as TILE_QUEUED).
+	std::sort(wanted.begin(), wanted.end(), [](const Request& a, const Request& b) { return a.priority < b.priority; });
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < taken.size(); i++) {
+			std::unordered_map<uint64_t, Entry>::iterator it = entries.find(taken[i]);
+			if (it != entries.end() && it->second.state == TILE_QUEUED)
+				it->second.state = TILE_LOADING;
+		}
+		taken.clear();
+		for (size_t i = 0; i < queue.size(); i++) {
+			std::unordered_map<uint64_t, Entry>::iterator it = entries.find(queue[i]);
+			if (it != entries.end() && it->second.state == TILE_QUEUED && it->second.wantedFrame != frame)
+				entries.erase(it);
+		}
+		queue.clear();
+
+		size_t inFlight = 0;
+		for (std::unordered_map<uint64_t, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+			inFlight += it->second.state != TILE_RESIDENT;
+		for (size_t i = 0; i < wanted.size(); i++) {
+			std::unordered_map<uint64_t, Entry>::iterator it = entries.find(wanted[i].key);
+			if (it != entries.end()) {
+				if (it->second.state == TILE_QUEUED)
+					queue.push_back(wanted[i].key);
+				continue;
+			}
+			if (inFlight >= maxInFlight)
+				continue;
+			Entry& entry = entries[wanted[i].key];
+			entry.state = TILE_QUEUED;
+			entry.slot = -1;
+			entry.lastUsed = 0;
+			entry.wantedFrame = frame;
+			queue.push_back(wanted[i].key);
+			inFlight++;
+		}
+		stats.bytesInFlight = inFlight * tileBytes;
+	}
+	wake.notify_all();
+
+	// Uploads: oldest finished tile first, up to the per-frame cap
+	StreamClock::time_point uploadStart = StreamClock::now();
+	stats.bytesUploaded = 0;
+	size_t consumed = 0;
+	for (; consumed < readyOrder.size(); consumed++) {
+		std::unordered_map<uint64_t, Entry>::iterator it = entries.find(readyOrder[consumed]);
+		if (it == entries.end() || it->second.state != TILE_READY)
+			continue;
+		if (stats.bytesUploaded > 0 && stats.bytesUploaded + tileBytes > uploadBytesPerFrame)
+			break;
+		int slot = AllocateSlot();
+		if (slot < 0)
+			break;
+		// the map may have lost the victim, look the tile up again
+		Entry& entry = entries[readyOrder[consumed]];
+		entry.slot = slot;
+		entry.lastUsed = frame;
+		Upload(entry);
+		stats.bytesUploaded += tileBytes;
+		stats.bytesInFlight -= tileBytes;
+	}
+	readyOrder.erase(readyOrder.begin(), readyOrder.begin() + consumed);
+	stats.uploadMs = MsSince(uploadStart);
+
+	stats.resident = 0;
+	for (std::unordered_map<uint64_t, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+		stats.resident += it->second.state == TILE_RESIDENT;
+	stats.updateMs = MsSince(start);
+}
+
+void TileStreamer::Draw(const Uniforms& uniforms) const
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	for (size_t i = 0; i < drawList.size(); i++) {
+		glUniform1i(uniforms.slot, drawList[i].slot);
+		glUniform2i(uniforms.tileOrigin, drawList[i].originCol, drawList[i].originRow);
+		glUniform1i(uniforms.tileStep, drawList[i].step);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, (void*)0);
+	}
+}
@@ -0,0 +1,159 @@
+#ifndef TERRAIN_STREAM_HPP
+#define TERRAIN_STREAM_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "heightfield.hpp"
+#include "stream_buffer.hpp"
+#include "terrain_tiles.hpp"
+
+// Streams the tiles of a .thf file (terrain_tiles.hpp) around the camera.
+//
+// Each Update walks the tile quadtree from the coarsest level: a tile is refined into its four
+// children while the camera is within lodRange tile sides of it and all children are resident,
+// otherwise it is drawn. Missing tiles are queued nearest first; background workers read and
+// decode them, and the render thread only uploads finished tiles into a fixed number of texture
+// array slots, at most uploadBytesPerFrame per frame. A full cache evicts the least recently used
+// tile that was not needed this frame. The coarsest level is loaded in Init and never evicted,
+// so the whole map is always covered and no frame ever waits for a read.
+//
+// Tiles are drawn with shader/stream_vertexshader.glsl. Neighbouring tiles of different levels
+// are not stitched, small cracks can show along such borders.
+class TileStreamer {
+public:
+	// Uniform locations of the streaming program
+	struct Uniforms {
+		GLint slot;
+		GLint tileOrigin;
+		GLint tileStep;
+	};
+
+	struct Stats {
+		size_t hits;            // tile lookups served by the cache, since Init
+		size_t misses;          // lookups of tiles that were not resident yet
+		size_t tilesLoaded;     // reads finished by the workers, since Init
+		size_t bytesInFlight;   // queued, loading or decoded tiles that are not uploaded yet
+		size_t bytesUploaded;   // last Update
+		size_t resident;        // tiles in the texture array
+		size_t slots;
+		float uploadMs;         // last Update: time spent in texture uploads
+		float updateMs;         // last Update: whole call
+
+		float HitRate() const { return hits + misses ? (float)hits / (hits + misses) : 0.0f; }
+	};
+
+	TileStreamer();
+	~TileStreamer();
+
+	// cacheBytes sets the number of texture array slots, uploadBytesPerFrame caps the uploads of
+	// one Update (one tile is always allowed). Without createGL tiles are cached but never
+	// uploaded, which is enough to measure streaming.
+	bool Init(const char* path, float spacing, float heightScale, int workerCount, size_t cacheBytes,
+		size_t uploadBytesPerFrame, bool createGL = true);
+	// Stops the workers and releases the GL objects
+	void Shutdown();
+
+	// Tiles are copied into buffer and uploaded from there (pixel unpack) instead of client memory
+	void SetUploadBuffer(StreamBuffer* buffer) { uploadBuffer = buffer; }
+
+	// A tile is refined while the camera is closer than range times its side
+	void SetLodRange(float range) { lodRange = range; }
+
+	// Selects the tiles to draw for camera (model space), queues missing ones, uploads finished ones
+	void Update(const glm::vec3& camera);
+
+	// Program must be bound with tileVerts = GetTileSize() + 1 and mapSize set
+	void Draw(const Uniforms& uniforms) const;
+
+	GLuint GetTexture() const { return texture; }
+	int GetTileSize() const { return tileSize; }
+	int GetWidth() const { return file.GetWidth(); }
+	int GetHeight() const { return file.GetHeight(); }
+	HEIGHT_FORMAT GetFormat() const { return file.GetFormat(); }
+	size_t GetTileBytes() const { return tileBytes; }
+	size_t GetDrawnTiles() const { return drawList.size(); }
+	size_t GetTriangleCount() const { return drawList.size() * tileSize * tileSize * 2; }
+	const Stats& GetStats() const { return stats; }
+
+private:
+	enum TILE_STATE { TILE_QUEUED, TILE_LOADING, TILE_READY, TILE_RESIDENT };
+
+	struct Entry {
+		TILE_STATE state;
+		int slot;
+		unsigned int lastUsed;    // frame the tile was last visited while resident
+		unsigned int wantedFrame; // frame the tile was last requested
+		Heightfield data;         // decoded samples while TILE_READY
+	};
+
+	struct Request {
+		uint64_t key;
+		float priority;           // distance in tile sides, nearest first
+	};
+
+	struct Loaded {
+		uint64_t key;
+		bool ok;
+		Heightfield data;
+	};
+
+	struct DrawTile {
+		int slot;
+		int originCol, originRow; // level 0 samples
+		int step;
+	};
+
+	TiledHeightfield file;
+	int tileSize;
+	int topLevel;
+	size_t tileBytes;
+	float spacing;
+	float heightScale;
+	float lodRange;
+	size_t uploadBytesPerFrame;
+	size_t maxInFlight;
+	unsigned int frame;
+	std::unordered_map<uint64_t, Entry> entries;   // render thread only
+	std::vector<int> freeSlots;
+	std::vector<uint64_t> readyOrder;
+	std::vector<Request> wanted;
+	std::vector<DrawTile> drawList;
+	Stats stats;
+	GLuint texture;
+	GLuint indexBuffer;
+	GLenum indexType;
+	GLsizei indexCount;
+	StreamBuffer* uploadBuffer;
+
+	// shared with the workers
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<uint64_t> queue;      // not taken by a worker yet, highest priority first
+	std::vector<uint64_t> taken;     // taken since the last Update
+	std::vector<Loaded> done;
+	bool stopping;
+	std::vector<std::thread> workers;
+
+	static uint64_t Key(int level, int row, int col) { return ((uint64_t)level << 48) | ((uint64_t)row << 24) | (uint64_t)col; }
+	static int KeyLevel(uint64_t key) { return (int)(key >> 48); }
+	static int KeyRow(uint64_t key) { return (int)((key >> 24) & 0xFFFFFF); }
+	static int KeyCol(uint64_t key) { return (int)(key & 0xFFFFFF); }
+
+	void WorkerLoop();
+	float Distance(const glm::vec3& camera, int level, int row, int col) const;
+	bool Want(int level, int row, int col, float priority);
+	void Select(const glm::vec3& camera, int level, int row, int col);
+	int AllocateSlot();
+	void Upload(Entry& entry);
+};
+
+#endif
@@ -0,0 +1,399 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "terrain_tiles.hpp"
+#include "trace.hpp"
+
+static void CopyTileSamples(const Heightfield& heights, int level, int tileSize, int tileRow, int tileCol,
+	Heightfield& out)
+{
+	const int side = tileSize + 1;
+	const int levelW = TileLevelSize(heights.width, level), levelH = TileLevelSize(heights.height, level);
+	out.width = out.height = side;
+	out.format = heights.format;
+	if (heights.format == HEIGHT_FORMAT::R16)
+		out.r16.resize((size_t)side * side);
+	else
+		out.r32f.resize((size_t)side * side);
+	for (int r = 0; r < side; r++) {
+		int lr = tileRow * tileSize + r < levelH - 1 ? tileRow * tileSize + r : levelH - 1;
+		int sr = (lr << level) < heights.height - 1 ? lr << level : heights.height - 1;
+		for (int c = 0; c < side; c++) {
+			int lc = tileCol * tileSize + c < levelW - 1 ? tileCol * tileSize + c : levelW - 1;
+			int sc = (lc << level) < heights.width - 1 ? lc << level : heights.width - 1;
+			size_t src = (size_t)sr * heights.width + sc, dst = (size_t)r * side + c;
+			if (heights.format == HEIGHT_FORMAT::R16)
+				out.r16[dst] = heights.r16[src];
+			else
+				out.r32f[dst] = heights.r32f[src];
+		}
+	}
+}
+
+// Plane through the left, upper and upper-left samples; first row/column: the previous sample
+static inline int Predict(const unsigned short* samples, int side, int r, int c)
+{
+	if (r == 0)
+		return c > 0 ? samples[c - 1] : 0;
+	if (c == 0)
+		return samples[(r - 1) * side];
+	int p = samples[r * side + c - 1] + samples[(r - 1) * side + c] - samples[(r - 1) * side + c - 1];
+	return p < 0 ? 0 : (p > 65535 ? 65535 : p);
+}
+
+// samples are divided by unit (1, or 257 for widened 8-bit tiles) before prediction
+static void EncodePlaneVarint(const unsigned short* samples, int side, int unit, std::vector<unsigned short>& scratch,
+	std::vector<unsigned char>& out)
+{
+	scratch.resize((size_t)side * side);
+	for (size_t i = 0; i < scratch.size(); i++)
+		scratch[i] = (unsigned short)(samples[i] / unit);
+	samples = &scratch[0];
+	out.clear();
+	for (int r = 0; r < side; r++) {
+		for (int c = 0; c < side; c++) {
+			int prev = Predict(samples, side, r, c);
+			int delta = samples[r * side + c] - prev;
+			unsigned int zigzag = delta >= 0 ? (unsigned int)delta << 1 : ((unsigned int)(-delta) << 1) - 1;
+			do {
+				unsigned char byte = zigzag & 0x7F;
+				zigzag >>= 7;
+				out.push_back(zigzag ? byte | 0x80 : byte);
+			} while (zigzag);
+		}
+	}
+}
+
+static bool DecodePlaneVarint(const unsigned char* data, size_t size, int side, int unit, unsigned short* samples)
+{
+	const unsigned char* end = data + size;
+	for (int r = 0; r < side; r++) {
+		for (int c = 0; c < side; c++) {
+			unsigned int zigzag = 0;
+			int shift = 0;
+			while (true) {
+				if (data == end || shift > 14)
+					return false;
+				unsigned char byte = *data++;
+				zigzag |= (unsigned int)(byte & 0x7F) << shift;
+				shift += 7;
+				if (!(byte & 0x80))
+					break;
+			}
+			int delta = (zigzag & 1) ? -(int)((zigzag + 1) >> 1) : (int)(zigzag >> 1);
+			int prev = Predict(samples, side, r, c);
+			samples[r * side + c] = (unsigned short)(prev + delta);
+		}
+	}
+	if (unit != 1) {
+		for (size_t i = 0; i < (size_t)side * side; i++)
+			samples[i] = (unsigned short)(samples[i] * unit);
+	}
+	return data == end;
+}
+
+bool WriteTiledHeightfield(const Heightfield& heights, const char* path, int tileSize, int levels,
+	TILE_COMPRESSION compression, int threadCount)
+{
+	TRACE_SCOPE("WriteTiledHeightfield");
+	if (tileSize < 16 || tileSize > 1024 || (tileSize & (tileSize - 1)) != 0) {
+		printf("%s: tile size must be a power of two in 16..1024\n", path);
+		return false;
+	}
+	if (heights.width < 2 || heights.height < 2) {
+		printf("%s: heightfield is too small\n", path);
+		return false;
+	}
+	if (levels <= 0) {
+		levels = 1;
+		while (TileLevelSize(heights.width, levels - 1) - 1 > tileSize || TileLevelSize(heights.height, levels - 1) - 1 > tileSize)
+			levels++;
+	}
+	if (heights.format != HEIGHT_FORMAT::R16)
+		compression = TILE_COMPRESSION::NONE;
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		printf("%s could not be opened for writing.\n", path);
+		return false;
+	}
+	TileFileHeader header;
+	memcpy(header.magic, THF_MAGIC, 4);
+	header.version = THF_VERSION;
+	header.width = heights.width;
+	header.height = heights.height;
+	header.tileSize = tileSize;
+	header.format = (uint32_t)heights.format;
+	header.levels = levels;
+	header.reserved = 0;
+	header.indexOffset = 0;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	// One level at a time: tiles are encoded in parallel, then appended in index order
+	std::vector<TileIndexEntry> index;
+	uint64_t offset = sizeof(header);
+	for (int level = 0; level < levels && ok; level++) {
+		const int tilesX = (TileLevelSize(heights.width, level) - 2) / tileSize + 1;
+		const int tilesZ = (TileLevelSize(heights.height, level) - 2) / tileSize + 1;
+		std::vector<std::vector<unsigned char> > blobs((size_t)tilesX * tilesZ);
+		std::vector<uint32_t> stored(blobs.size());
+		ParallelFor(0, tilesZ, threadCount, [&](int rowBegin, int rowEnd) {
+			Heightfield tile;
+			std::vector<unsigned char> packed;
+			std::vector<unsigned short> scratch;
+			for (int tr = rowBegin; tr < rowEnd; tr++) {
+				for (int tc = 0; tc < tilesX; tc++) {
+					size_t t = (size_t)tr * tilesX + tc;
+					CopyTileSamples(heights, level, tileSize, tr, tc, tile);
+					const unsigned char* raw = (const unsigned char*)tile.Data();
+					blobs[t].assign(raw, raw + tile.ByteSize());
+					stored[t] = (uint32_t)TILE_COMPRESSION::NONE;
+					if (compression != TILE_COMPRESSION::NONE) {
+						// 8-bit sources are widened with * 257: code them in their own steps
+						bool widened = true;
+						for (size_t i = 0; i < tile.r16.size() && widened; i++)
+							widened = tile.r16[i] % 257 == 0;
+						EncodePlaneVarint(&tile.r16[0], tileSize + 1, widened ? 257 : 1, scratch, packed);
+						// keep the raw tile when compression does not pay off
+						if (packed.size() < blobs[t].size()) {
+							blobs[t].swap(packed);
+							stored[t] = (uint32_t)(widened ? TILE_COMPRESSION::PLANE_VARINT_8BIT : TILE_COMPRESSION::PLANE_VARINT);
+						}
+					}
+				}
+			}
+		});
+		for (size_t t = 0; t < blobs.size() && ok; t++) {
+			TileIndexEntry entry;
+			entry.offset = offset;
+			entry.size = (uint32_t)blobs[t].size();
+			entry.compression = stored[t];
+			index.push_back(entry);
+			ok = fwrite(&blobs[t][0], 1, blobs[t].size(), file) == blobs[t].size();
+			offset += blobs[t].size();
+		}
+	}
+
+	header.indexOffset = offset;
+	ok = ok && fwrite(&index[0], sizeof(TileIndexEntry), index.size(), file) == index.size();
+	ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		printf("%s: write failed\n", path);
+	return ok;
+}
+
+bool ConvertToTiledHeightfield(const char* source, const char* path, int tileSize, int levels,
+	TILE_COMPRESSION compression)
+{
+	TRACE_SCOPE("ConvertToTiledHeightfield");
+	Heightfield heights;
+	if (!LoadHeightfield(source, heights))
+		return false;
+	if (!WriteTiledHeightfield(heights, path, tileSize, levels, compression))
+		return false;
+	TiledHeightfield tiles;
+	if (!tiles.Open(path))
+		return false;
+	size_t tileCount = 0, stored = 0;
+	for (int l = 0; l < tiles.GetLevelCount(); l++) {
+		for (int tr = 0; tr < tiles.GetTilesZ(l); tr++) {
+			for (int tc = 0; tc < tiles.GetTilesX(l); tc++) {
+				stored += tiles.GetEntry(l, tr, tc).size;
+				tileCount++;
+			}
+		}
+	}
+	printf("%s: %dx%d, %d levels, %zu tiles of %d^2, %.1f MB (%.2f of raw tiles)\n", path, heights.width, heights.height,
+		tiles.GetLevelCount(), tileCount, tileSize, stored / (1024.0 * 1024.0),
+		(double)stored / (tileCount * (size_t)(tileSize + 1) * (tileSize + 1) * (heights.format == HEIGHT_FORMAT::R16 ? 2 : 4)));
+	return true;
+}
+
+TiledHeightfield::TiledHeightfield()
+	: file(-1)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+TiledHeightfield::~TiledHeightfield()
+{
+	Close();
+}
+
+void TiledHeightfield::Close()
+{
+	if (file == -1)
+		return;
+#ifdef _WIN32
+	CloseHandle((HANDLE)file);
+#else
+	close((int)file);
+#endif
+	file = -1;
+	index.clear();
+}
+
+bool TiledHeightfield::ReadAt(uint64_t offset, size_t size, void* dst) const
+{
+#ifdef _WIN32
+	// Positional read on a synchronous handle: no shared file pointer between threads
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD read = 0;
+	return ReadFile((HANDLE)file, dst, (DWORD)size, &read, &overlapped) && read == size;
+#else
+	char* out = (char*)dst;
+	while (size > 0) {
+		ssize_t read = pread((int)file, out, size, (off_t)offset);
+		if (read <= 0)
+			return false;
+		out += read;
+		offset += read;
+		size -= read;
+	}
+	return true;
+#endif
+}
+
+bool TiledHeightfield::Open(const char* path)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	file = handle == INVALID_HANDLE_VALUE ? -1 : (intptr_t)handle;
+#else
+	file = open(path, O_RDONLY);
+#endif
+	if (file == -1) {
+		printf("%s could not be opened.\n", path);
+		return false;
+	}
+	if (!ReadAt(0, sizeof(header), &header) || memcmp(header.magic, THF_MAGIC, 4) != 0 || header.version != THF_VERSION) {
+		printf("%s: not a tiled heightfield\n", path);
+		Close();
+		return false;
+	}
+	if (header.width < 2 || header.height < 2 || header.tileSize < 16 || header.tileSize > 1024 ||
+		header.levels < 1 || header.levels > 24 || header.format > (uint32_t)HEIGHT_FORMAT::R32F) {
+		printf("%s: corrupt header\n", path);
+		Close();
+		return false;
+	}
+
+	levelTilesX.resize(header.levels);
+	levelTilesZ.resize(header.levels);
+	levelFirst.resize(header.levels);
+	size_t tiles = 0;
+	for (uint32_t l = 0; l < header.levels; l++) {
+		levelTilesX[l] = (TileLevelSize(header.width, l) - 2) / header.tileSize + 1;
+		levelTilesZ[l] = (TileLevelSize(header.height, l) - 2) / header.tileSize + 1;
+		levelFirst[l] = (int)tiles;
+		tiles += (size_t)levelTilesX[l] * levelTilesZ[l];
+	}
+	index.resize(tiles);
+	if (!ReadAt(header.indexOffset, tiles * sizeof(TileIndexEntry), &index[0])) {
+		printf("%s: truncated tile index\n", path);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+const TileIndexEntry& TiledHeightfield::GetEntry(int level, int tileRow, int tileCol) const
+{
+	return index[levelFirst[level] + tileRow * levelTilesX[level] + tileCol];
+}
+
+bool TiledHeightfield::ReadTile(int level, int tileRow, int tileCol, Heightfield& out) const
+{
+	TRACE_SCOPE("TiledHeightfield::ReadTile");
+	if (file == -1 || level < 0 || level >= (int)header.levels ||
+		tileRow < 0 || tileRow >= levelTilesZ[level] || tileCol < 0 || tileCol >= levelTilesX[level])
+		return false;
+	const TileIndexEntry& entry = GetEntry(level, tileRow, tileCol);
+	const int side = header.tileSize + 1;
+	const size_t count = (size_t)side * side;
+	out.width = out.height = side;
+	out.format = (HEIGHT_FORMAT)header.format;
+	if (out.format == HEIGHT_FORMAT::R16) {
+		out.r32f.clear();
+		out.r16.resize(count);
+	}
+	else {
+		out.r16.clear();
+		out.r32f.resize(count);
+	}
+
+	if (entry.compression == (uint32_t)TILE_COMPRESSION::NONE) {
+		if (entry.size != out.ByteSize())
+			return false;
+		return ReadAt(entry.offset, entry.size, out.format == HEIGHT_FORMAT::R16 ? (void*)&out.r16[0] : (void*)&out.r32f[0]);
+	}
+	if (out.format != HEIGHT_FORMAT::R16 || (entry.compression != (uint32_t)TILE_COMPRESSION::PLANE_VARINT &&
+		entry.compression != (uint32_t)TILE_COMPRESSION::PLANE_VARINT_8BIT))
+		return false;
+	// scratch buffer per thread, tiles are read from the streaming workers
+	static thread_local std::vector<unsigned char> packed;
+	packed.resize(entry.size);
+	if (!ReadAt(entry.offset, entry.size, &packed[0]))
+		return false;
+	const int unit = entry.compression == (uint32_t)TILE_COMPRESSION::PLANE_VARINT_8BIT ? 257 : 1;
+	return DecodePlaneVarint(&packed[0], packed.size(), side, unit, &out.r16[0]);
+}
+
+bool LoadHeightfieldTiled(const char* path, int level, Heightfield& out)
+{
+	TiledHeightfield tiles;
+	if (!tiles.Open(path))
+		return false;
+	if (level < 0 || level >= tiles.GetLevelCount()) {
+		printf("%s: no level %d\n", path, level);
+		return false;
+	}
+	const int tileSize = tiles.GetTileSize();
+	out.width = TileLevelSize(tiles.GetWidth(), level);
+	out.height = TileLevelSize(tiles.GetHeight(), level);
+	out.format = tiles.GetFormat();
+	out.r16.clear();
+	out.r32f.clear();
+	if (out.format == HEIGHT_FORMAT::R16)
+		out.r16.resize((size_t)out.width * out.height);
+	else
+		out.r32f.resize((size_t)out.width * out.height);
+
+	Heightfield tile;
+	for (int tr = 0; tr < tiles.GetTilesZ(level); tr++) {
+		for (int tc = 0; tc < tiles.GetTilesX(level); tc++) {
+			if (!tiles.ReadTile(level, tr, tc, tile)) {
+				printf("%s: tile %d/%d of level %d is corrupt\n", path, tr, tc, level);
+				return false;
+			}
+			const int rows = out.height - tr * tileSize < tileSize + 1 ? out.height - tr * tileSize : tileSize + 1;
+			const int cols = out.width - tc * tileSize < tileSize + 1 ? out.width - tc * tileSize : tileSize + 1;
+			for (int r = 0; r < rows; r++) {
+				size_t dst = (size_t)(tr * tileSize + r) * out.width + tc * tileSize;
+				size_t src = (size_t)r * tile.width;
+				if (out.format == HEIGHT_FORMAT::R16)
+					memcpy(&out.r16[dst], &tile.r16[src], cols * sizeof(unsigned short));
+				else
+					memcpy(&out.r32f[dst], &tile.r32f[src], cols * sizeof(float));
+			}
+		}
+	}
+	return true;
+}
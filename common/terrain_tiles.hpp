@@ -0,0 +1,103 @@
+#ifndef TERRAIN_TILES_HPP
+#define TERRAIN_TILES_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "heightfield.hpp"
+
+/*
+    Tiled heightfield file (.thf), little-endian:
+
+    TileFileHeader
+    tile data, in any order
+    TileIndexEntry[tiles of level 0 + tiles of level 1 + ...] at header.indexOffset,
+    each level row-major (tileRow * tilesX + tileCol)
+
+    Level l point-samples level 0 every 2^l samples (the last row/column is always kept),
+    so a coarse vertex lies exactly on a fine one. Every tile holds (tileSize + 1)^2 samples:
+    neighbouring tiles share their border row/column, tiles hanging over the edge repeat it.
+    R16 tiles can be stored compressed (plane prediction + varint), each is read with one positional
+    read, so several threads can fetch tiles through the same TiledHeightfield.
+*/
+
+static const char THF_MAGIC[4] = { 'T', 'H', 'F', '1' };
+static const uint32_t THF_VERSION = 1;
+
+enum class TILE_COMPRESSION : uint32_t {
+	NONE,
+	PLANE_VARINT,       // R16: residual to the plane through the left, upper and upper-left samples,
+	                    // zigzag LEB128 (first row/column: residual to the previous sample)
+	PLANE_VARINT_8BIT   // the same on samples / 257, for tiles of widened 8-bit samples
+};
+
+struct TileFileHeader {
+	char magic[4];          // THF_MAGIC
+	uint32_t version;       // THF_VERSION
+	uint32_t width;         // level 0 samples
+	uint32_t height;
+	uint32_t tileSize;      // quads per tile side
+	uint32_t format;        // HEIGHT_FORMAT
+	uint32_t levels;
+	uint32_t reserved;
+	uint64_t indexOffset;
+};
+
+struct TileIndexEntry {
+	uint64_t offset;
+	uint32_t size;          // stored bytes
+	uint32_t compression;   // TILE_COMPRESSION
+};
+
+// Samples per side of level l
+inline int TileLevelSize(int size, int level)
+{
+	return ((size - 1) + (1 << level) - 1) / (1 << level) + 1;
+}
+
+// Reader. Open() loads the header and the tile index, tiles are read on demand.
+class TiledHeightfield {
+public:
+	TiledHeightfield();
+	~TiledHeightfield();
+
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen() const { return file != -1; }
+
+	int GetWidth() const { return header.width; }
+	int GetHeight() const { return header.height; }
+	int GetTileSize() const { return header.tileSize; }
+	int GetLevelCount() const { return header.levels; }
+	HEIGHT_FORMAT GetFormat() const { return (HEIGHT_FORMAT)header.format; }
+	int GetTilesX(int level) const { return levelTilesX[level]; }    // tile columns
+	int GetTilesZ(int level) const { return levelTilesZ[level]; }    // tile rows
+	const TileIndexEntry& GetEntry(int level, int tileRow, int tileCol) const;
+
+	// Reads and decodes one tile into out ((tileSize + 1)^2 samples). Thread-safe.
+	bool ReadTile(int level, int tileRow, int tileCol, Heightfield& out) const;
+
+private:
+	intptr_t file;                     // fd, or HANDLE on Windows; -1 when closed
+	TileFileHeader header;
+	std::vector<TileIndexEntry> index;
+	std::vector<int> levelTilesX, levelTilesZ, levelFirst;
+
+	bool ReadAt(uint64_t offset, size_t size, void* dst) const;
+};
+
+// Converter: splits heights into tiles of tileSize quads (power of two, 16..1024) with
+// levels mip levels (<= 0: until one tile covers the whole level). Any compression other than
+// NONE picks PLANE_VARINT or PLANE_VARINT_8BIT per tile, and keeps tiles it cannot shrink raw.
+bool WriteTiledHeightfield(const Heightfield& heights, const char* path, int tileSize, int levels,
+	TILE_COMPRESSION compression, int threadCount = 0);
+
+// Loads any heightfield LoadHeightfield() understands and writes it as a .thf file
+bool ConvertToTiledHeightfield(const char* source, const char* path, int tileSize, int levels = 0,
+	TILE_COMPRESSION compression = TILE_COMPRESSION::PLANE_VARINT);
+
+// Assembles one level of a .thf file into a plain heightfield
+bool LoadHeightfieldTiled(const char* path, int level, Heightfield& out);
+
+#endif
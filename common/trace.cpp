@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "trace.hpp"
+
+std::atomic<bool> g_traceEnabled(false);
+
+struct TraceEvent {
+	const char* name;
+	int64_t start;
+	int64_t duration;
+};
+
+// Written by one thread only; count is published after the event it covers.
+// The owner restarts the buffer at its first event of a new capture (epoch), so no other
+// thread ever writes count.
+struct TraceBuffer {
+	static const uint32_t CAPACITY = 1 << 16;
+
+	std::atomic<uint32_t> count;
+	std::atomic<uint32_t> epoch;     // capture the events belong to
+	std::atomic<const char*> threadName;
+	uint32_t tid;
+	TraceEvent events[CAPACITY];
+};
+
+static std::mutex registryMutex;
+static std::vector<TraceBuffer*> registry;    // never freed, so events of finished threads can still be written
+static std::atomic<size_t> droppedEvents(0);
+static std::atomic<uint32_t> captureEpoch(0);   // bumped by TraceStart
+static thread_local TraceBuffer* threadBuffer = NULL;
+static thread_local const char* threadName = NULL;
+static TraceBuffer* gpuBuffer = NULL;
+
+static TraceBuffer* RegisterBuffer(const char* name)
+{
+	TraceBuffer* buffer = new TraceBuffer;
+	buffer->count.store(0, std::memory_order_relaxed);
+	buffer->epoch.store(captureEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	buffer->threadName.store(name, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer->tid = (uint32_t)registry.size() + 1;
+	registry.push_back(buffer);
+	return buffer;
+}
+
+static void Append(TraceBuffer* buffer, const char* name, int64_t startNs, int64_t endNs)
+{
+	// Acquire pairs with TraceStart: a TraceWrite before it is done reading what gets overwritten here
+	const uint32_t epoch = captureEpoch.load(std::memory_order_acquire);
+	if (buffer->epoch.load(std::memory_order_relaxed) != epoch) {
+		// First event of a new capture: drop the previous one (TraceWrite checks epoch before count)
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->epoch.store(epoch, std::memory_order_release);
+	}
+	const uint32_t i = buffer->count.load(std::memory_order_relaxed);
+	if (i >= TraceBuffer::CAPACITY) {
+		droppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	buffer->events[i].name = name;
+	buffer->events[i].start = startNs;
+	buffer->events[i].duration = endNs - startNs;
+	buffer->count.store(i + 1, std::memory_order_release);
+}
+
+void TraceStart()
+{
+	TraceNow();
+	droppedEvents.store(0, std::memory_order_relaxed);
+	captureEpoch.fetch_add(1, std::memory_order_release);
+	g_traceEnabled.store(true, std::memory_order_relaxed);
+}
+
+void TraceStop()
+{
+	g_traceEnabled.store(false, std::memory_order_relaxed);
+}
+
+int64_t TraceNow()
+{
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void TraceSetThreadName(const char* name)
+{
+	threadName = name;
+	if (threadBuffer)
+		threadBuffer->threadName.store(name, std::memory_order_relaxed);
+}
+
+void TraceComplete(const char* name, int64_t startNs, int64_t endNs)
+{
+	if (threadBuffer == NULL)
+		threadBuffer = RegisterBuffer(threadName);
+	Append(threadBuffer, name, startNs, endNs);
+}
+
+void TraceGpuComplete(const char* name, int64_t startNs, int64_t endNs)
+{
+	if (gpuBuffer == NULL)
+		gpuBuffer = RegisterBuffer("GPU");
+	Append(gpuBuffer, name, startNs, endNs);
+}
+
+size_t TraceGetDroppedEvents()
+{
+	return droppedEvents.load(std::memory_order_relaxed);
+}
+
+bool TraceWrite(const char* path)
+{
+	std::vector<TraceBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffers = registry;
+	}
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("%s could not be opened for writing.\n", path);
+		return false;
+	}
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	const uint32_t epoch = captureEpoch.load(std::memory_order_relaxed);
+	bool first = true;
+	size_t events = 0, threads = 0;
+	for (size_t b = 0; b < buffers.size(); b++) {
+		const TraceBuffer& buffer = *buffers[b];
+		// Threads that recorded nothing since TraceStart still hold an older capture
+		if (buffer.epoch.load(std::memory_order_acquire) != epoch)
+			continue;
+		threads++;
+		const char* name = buffer.threadName.load(std::memory_order_relaxed);
+		if (name) {
+			fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+				first ? "" : ",\n", buffer.tid, name);
+			first = false;
+		}
+		const uint32_t count = buffer.count.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < count; i++) {
+			const TraceEvent& event = buffer.events[i];
+			fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+				first ? "" : ",\n", event.name, buffer.tid, event.start / 1000.0, event.duration / 1000.0);
+			first = false;
+		}
+		events += count;
+	}
+	fprintf(file, "\n]}\n");
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	if (!ok) {
+		printf("%s: write failed\n", path);
+		return false;
+	}
+	printf("Wrote %zu trace events from %zu threads to %s (%zu dropped)\n", events, threads, path, TraceGetDroppedEvents());
+	return true;
+}
@@ -0,0 +1,73 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+    Chrome trace_event recording, for chrome://tracing or ui.perfetto.dev.
+
+    Every thread appends complete ("X") events to its own fixed-size buffer without locking; only
+    the first event of a thread takes a lock to register its buffer. Events that do not fit are
+    dropped and counted. Names must be string literals (only the pointer is kept).
+    Recording is off until TraceStart(); while it is off a TRACE_SCOPE costs one relaxed atomic load.
+    Buffers are reused: every TraceStart() begins a new capture, each thread's buffer starts over at
+    its first event of it, and TraceWrite() writes the current (or last) capture only. The buffer
+    capacity (64k events per thread) and the dropped count are per capture.
+    Define
+    #define TERRAIN_NO_TRACE
+    to compile the TRACE_ macros out entirely.
+*/
+
+extern std::atomic<bool> g_traceEnabled;
+
+inline bool TraceIsEnabled() { return g_traceEnabled.load(std::memory_order_relaxed); }
+void TraceStart();
+void TraceStop();
+
+// Nanoseconds on the steady clock since the first call
+int64_t TraceNow();
+// Name of the calling thread in the trace (a string literal)
+void TraceSetThreadName(const char* name);
+// Event of the calling thread
+void TraceComplete(const char* name, int64_t startNs, int64_t endNs);
+// Event on the "GPU" track, times already converted to TraceNow(). Only one thread may call it.
+void TraceGpuComplete(const char* name, int64_t startNs, int64_t endNs);
+// Events that did not fit in their buffer since the last TraceStart
+size_t TraceGetDroppedEvents();
+
+// Writes the events recorded since the last TraceStart (recording may go on)
+bool TraceWrite(const char* path);
+
+class TraceScope {
+public:
+	explicit TraceScope(const char* name)
+		: name(name), start(TraceIsEnabled() ? TraceNow() : -1)
+	{
+	}
+	~TraceScope()
+	{
+		if (start >= 0)
+			TraceComplete(name, start, TraceNow());
+	}
+
+private:
+	const char* name;
+	int64_t start;
+
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifndef TERRAIN_NO_TRACE
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) TraceSetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif
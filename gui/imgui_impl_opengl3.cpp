@@ -14,6 +14,7 @@
 
 // CHANGELOG
 // (minor and older changes stripped away, please see git history for details)
+//  2026-10-17: OpenGL: Added ImGui_ImplOpenGL3_SetUploadFn() to upload vertex/index data through an application ring buffer.
 //  2021-08-23: OpenGL: Fixed ES 3.0 shader ("#version 300 es") use normal precision floats to avoid wobbly rendering at HD resolutions.
 //  2021-08-19: OpenGL: Embed and use our own minimal GL loader (imgui_impl_opengl3_loader.h), removing requirement and support for third-party loader.
 //  2021-06-29: Reorganized backend to pull data from a single structure to facilitate usage with multiple-contexts (all g_XXXX access changed to bd->XXXX).
@@ -175,6 +176,8 @@ struct ImGui_ImplOpenGL3_Data
     GLuint          AttribLocationVtxColor;
     unsigned int    VboHandle, ElementsHandle;
     bool            HasClipOrigin;
+    ImGui_ImplOpenGL3_UploadFn UploadFn;     // Optional, see ImGui_ImplOpenGL3_SetUploadFn()
+    void*           UploadUserData;
 
     ImGui_ImplOpenGL3_Data() { memset(this, 0, sizeof(*this)); }
 };
@@ -287,6 +290,14 @@ void    ImGui_ImplOpenGL3_NewFrame()
         ImGui_ImplOpenGL3_CreateDeviceObjects();
 }
 
+// Points the ImDrawVert attributes at 'vtx_offset' bytes into the bound GL_ARRAY_BUFFER
+static void ImGui_ImplOpenGL3_SetupVertexAttribs(ImGui_ImplOpenGL3_Data* bd, size_t vtx_offset)
+{
+    glVertexAttribPointer(bd->AttribLocationVtxPos,   2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(vtx_offset + IM_OFFSETOF(ImDrawVert, pos)));
+    glVertexAttribPointer(bd->AttribLocationVtxUV,    2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(vtx_offset + IM_OFFSETOF(ImDrawVert, uv)));
+    glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(ImDrawVert), (GLvoid*)(vtx_offset + IM_OFFSETOF(ImDrawVert, col)));
+}
+
 static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height, GLuint vertex_array_object)
 {
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
@@ -355,9 +366,15 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
     glEnableVertexAttribArray(bd->AttribLocationVtxPos);
     glEnableVertexAttribArray(bd->AttribLocationVtxUV);
     glEnableVertexAttribArray(bd->AttribLocationVtxColor);
-    glVertexAttribPointer(bd->AttribLocationVtxPos,   2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
-    glVertexAttribPointer(bd->AttribLocationVtxUV,    2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
-    glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+    ImGui_ImplOpenGL3_SetupVertexAttribs(bd, 0);
+}
+
+void    ImGui_ImplOpenGL3_SetUploadFn(ImGui_ImplOpenGL3_UploadFn upload_fn, void* user_data)
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    IM_ASSERT(bd != NULL && "Did you call ImGui_ImplOpenGL3_Init()?");
+    bd->UploadFn = upload_fn;
+    bd->UploadUserData = user_data;
 }
 
 // OpenGL3 Render function.
@@ -423,9 +440,33 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
 
-        // Upload vertex/index buffers
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        // Upload vertex/index buffers, through the application's streaming buffer when it has room
+        const size_t vtx_size = (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+        const size_t idx_size = (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        unsigned int vtx_buffer = 0, idx_buffer = 0;
+        size_t vtx_offset = 0, idx_offset = 0;
+        const bool used_ring = bd->UploadFn != NULL
+            && bd->UploadFn(cmd_list->VtxBuffer.Data, vtx_size, 4, &vtx_buffer, &vtx_offset, bd->UploadUserData)
+            && bd->UploadFn(cmd_list->IdxBuffer.Data, idx_size, sizeof(ImDrawIdx), &idx_buffer, &idx_offset, bd->UploadUserData);
+        if (used_ring)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vtx_buffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idx_buffer);
+            ImGui_ImplOpenGL3_SetupVertexAttribs(bd, vtx_offset);
+        }
+        else
+        {
+            // A failed upload may have left the vertex data in the ring; draw from our own buffers at offset 0
+            vtx_offset = idx_offset = 0;
+            if (bd->UploadFn != NULL)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ElementsHandle);
+                ImGui_ImplOpenGL3_SetupVertexAttribs(bd, 0);
+            }
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vtx_size, (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)idx_size, (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        }
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -435,7 +476,15 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 // User callback, registered via ImDrawList::AddCallback()
                 // (ImDrawCallback_ResetRenderState is a special callback value used by the user to request the renderer to reset render state.)
                 if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
+                {
                     ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
+                    if (used_ring)
+                    {
+                        glBindBuffer(GL_ARRAY_BUFFER, vtx_buffer);
+                        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idx_buffer);
+                        ImGui_ImplOpenGL3_SetupVertexAttribs(bd, vtx_offset);
+                    }
+                }
                 else
                     pcmd->UserCallback(cmd_list, pcmd);
             }
@@ -454,10 +503,10 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->GetTexID());
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
                 if (bd->GlVersion >= 320)
-                    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(idx_offset + pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset);
                 else
 #endif
-                glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)));
+                glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(idx_offset + pcmd->IdxOffset * sizeof(ImDrawIdx)));
             }
         }
     }
@@ -26,6 +26,13 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_Shutdown();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_NewFrame();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data);
 
+// (Optional) Route the per-frame vertex/index uploads through an application-owned streaming buffer instead of
+// re-specifying the backend's GL_STREAM_DRAW buffers for every draw list. The function copies 'size' bytes to a multiple
+// of 'alignment' in a buffer that stays valid until the GPU has drawn this frame, and returns that buffer's GL name and
+// the byte offset. Returning false makes the backend fall back to glBufferData for that draw list. Pass NULL to disable.
+typedef bool (*ImGui_ImplOpenGL3_UploadFn)(const void* data, size_t size, size_t alignment, unsigned int* out_buffer, size_t* out_offset, void* user_data);
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_SetUploadFn(ImGui_ImplOpenGL3_UploadFn upload_fn, void* user_data);
+
 // (Optional) Called by Init/NewFrame/Shutdown
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateFontsTexture();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
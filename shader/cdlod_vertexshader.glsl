@@ -0,0 +1,37 @@
+#version 330 core
+
+// CDLOD: one leafSize x leafSize grid per selected node, positions from gl_VertexID
+
+uniform mat4 MVP;
+uniform sampler2D heightTexture;  // GL_R16 (normalized) or GL_R32F, linear filtering
+uniform int gridSize;             // quads per node side
+uniform ivec2 nodeOrigin;         // (col, row) texel of the node's first vertex
+uniform int nodeStep;             // texels between vertices at the node's level
+uniform vec2 morphRange;          // distances where morphing to the next level starts / ends
+uniform vec3 cameraPosition;      // model space
+uniform float spacing;            // X/Z distance between samples
+uniform float heightScale;
+
+out vec3 fragmentColor;
+
+float heightAt(vec2 texel){
+	vec2 size = vec2(textureSize(heightTexture, 0));
+	return textureLod(heightTexture, (texel + 0.5) / size, 0.0).r * heightScale;
+}
+
+void main(){
+	vec2 size = vec2(textureSize(heightTexture, 0));
+	ivec2 g = ivec2(gl_VertexID % (gridSize + 1), gl_VertexID / (gridSize + 1));
+	vec2 texel = vec2(nodeOrigin + g * nodeStep);
+	vec2 clamped = min(texel, size - 1.0);
+	vec3 pos = vec3(clamped.y * spacing, heightAt(clamped), clamped.x * spacing);
+
+	// odd vertices slide onto the next coarser grid as the node nears the end of its range
+	float morphK = clamp((distance(pos, cameraPosition) - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+	texel -= vec2(g % 2) * morphK * float(nodeStep);
+	texel = min(texel, size - 1.0);
+	float y = heightAt(texel);
+
+	gl_Position = MVP * vec4(texel.y * spacing, y, texel.x * spacing, 1);
+	fragmentColor = vec3(y*300/255, 0, 1 - y*300/255);
+}
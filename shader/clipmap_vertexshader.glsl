@@ -0,0 +1,39 @@
+#version 330 core
+
+// Geometry clipmap level: gridVerts x gridVerts vertices from gl_VertexID,
+// heights from the level's toroidal layer of the clipmap texture
+
+uniform mat4 MVP;
+uniform sampler2DArray heightTexture;  // levelSize x levelSize per level, GL_R16 or GL_R32F
+uniform int gridVerts;                 // levelSize - 1
+uniform int levelSize;
+uniform int levelCount;
+uniform int level;
+uniform ivec2 levelOrigin;             // (col, row) of the first vertex, in level samples
+uniform float spacing;                 // X/Z distance between heightfield samples
+uniform float heightScale;
+
+out vec3 fragmentColor;
+
+float heightAt(ivec2 coord){
+	return texelFetch(heightTexture, ivec3(coord & (levelSize - 1), level), 0).r;
+}
+
+void main(){
+	ivec2 g = ivec2(gl_VertexID % gridVerts, gl_VertexID / gridVerts);
+	ivec2 coord = levelOrigin + g;
+	float h = heightAt(coord);
+
+	// odd vertices on the outer edge lie halfway between two vertices of the coarser level
+	if (level < levelCount - 1) {
+		if ((g.x == 0 || g.x == gridVerts - 1) && (g.y & 1) == 1)
+			h = 0.5 * (heightAt(coord - ivec2(0, 1)) + heightAt(coord + ivec2(0, 1)));
+		else if ((g.y == 0 || g.y == gridVerts - 1) && (g.x & 1) == 1)
+			h = 0.5 * (heightAt(coord - ivec2(1, 0)) + heightAt(coord + ivec2(1, 0)));
+	}
+
+	float y = h * heightScale;
+	vec2 pos = vec2(coord << level) * spacing;
+	gl_Position = MVP * vec4(pos.y, y, pos.x, 1);
+	fragmentColor = vec3(y*300/255, 0, 1 - y*300/255);
+}
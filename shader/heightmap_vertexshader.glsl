@@ -0,0 +1,44 @@
+#version 330 core
+
+// No vertex attributes: the grid position comes from gl_VertexID and the height from a texture
+
+uniform mat4 MVP;
+uniform sampler2D heightTexture;  // GL_R16 (normalized) or GL_R32F
+uniform int gridCols;             // vertices per row of the grid (or patch) being drawn
+uniform ivec2 gridOrigin;         // (col, row) of its first vertex in the heightfield
+uniform int vertexBase;           // baseVertex passed to the draw call
+uniform int chunkStride;          // > 0: multi-draw, chunk = gl_VertexID / chunkStride (see terrain_multidraw.hpp)
+uniform isamplerBuffer chunkTable; // per chunk (col, row, cols, rows), replaces gridOrigin/gridCols/vertexBase
+uniform float spacing;            // X/Z distance between samples
+uniform float heightScale;
+uniform sampler2D normalTexture;  // GL_RG16_SNORM hemi-octahedral normals (x, z), see terrain_normals.hpp
+uniform bool lighting;
+uniform vec3 lightDirection;      // towards the light, normalized
+
+out vec3 fragmentColor;
+
+void main(){
+	int local = gl_VertexID - vertexBase;
+	ivec2 origin = gridOrigin;
+	int cols = gridCols;
+	if (chunkStride > 0) {
+		int chunk = gl_VertexID / chunkStride;
+		ivec4 entry = texelFetch(chunkTable, chunk);
+		local = gl_VertexID - chunk * chunkStride;
+		origin = entry.xy;
+		cols = entry.z;
+	}
+	// patches hanging over the border collapse onto the last row/column
+	ivec2 size = textureSize(heightTexture, 0);
+	int row = min(origin.y + local / cols, size.y - 1);
+	int col = min(origin.x + local % cols, size.x - 1);
+	float y = texelFetch(heightTexture, ivec2(col, row), 0).r * heightScale;
+
+	gl_Position = MVP * vec4(row * spacing, y, col * spacing, 1);
+	fragmentColor = vec3(y*300/255, 0, 1 - y*300/255);
+	if (lighting) {
+		vec2 xz = texelFetch(normalTexture, ivec2(col, row), 0).rg;
+		vec3 normal = normalize(vec3(xz.x, max(1.0 - abs(xz.x) - abs(xz.y), 0.0), xz.y));
+		fragmentColor *= 0.35 + 0.65 * max(dot(normal, lightDirection), 0.0);
+	}
+}
\ No newline at end of file
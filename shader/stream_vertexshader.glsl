@@ -0,0 +1,26 @@
+#version 330 core
+
+// Streamed tiles (common/terrain_stream.hpp): one (tileVerts x tileVerts) grid per draw,
+// heights from the tile's layer of the texture array
+
+uniform mat4 MVP;
+uniform sampler2DArray tileTexture;  // GL_R16 (normalized) or GL_R32F, one tile per layer
+uniform int tileVerts;               // vertices per tile side
+uniform int slot;                    // layer of the tile being drawn
+uniform ivec2 tileOrigin;            // (col, row) of its first vertex in level 0 samples
+uniform int tileStep;                // level 0 samples between its vertices
+uniform ivec2 mapSize;               // level 0 (cols, rows)
+uniform float spacing;               // X/Z distance between level 0 samples
+uniform float heightScale;
+
+out vec3 fragmentColor;
+
+void main(){
+	ivec2 g = ivec2(gl_VertexID % tileVerts, gl_VertexID / tileVerts);
+	float y = texelFetch(tileTexture, ivec3(g, slot), 0).r * heightScale;
+	// tiles hanging over the border collapse onto the last row/column
+	ivec2 coord = min(tileOrigin + g * tileStep, mapSize - 1);
+
+	gl_Position = MVP * vec4(coord.y * spacing, y, coord.x * spacing, 1);
+	fragmentColor = vec3(y*300/255, 0, 1 - y*300/255);
+}
@@ -3,17 +3,28 @@
 layout(location = 0) in vec3 vertexPosition_modelspace;  // glEnableVertexAttribArray()
 layout(location = 1) in vec3 vertexColor;
 // layout(location = 2) in vec2 vertexUV;
+layout(location = 3) in uvec4 packedVertex;  // (col, row, height low, height high), see PackedVertexBuffer
 
 uniform mat4 MVP;
+uniform bool packedVertices;  // true: position comes from packedVertex instead of vertexPosition_modelspace
+uniform ivec2 gridOrigin;     // (col, row) the packed coordinates are relative to (per chunk)
+uniform float spacing;        // X/Z distance between samples
+uniform vec2 heightDecode;    // height = heightDecode.x + quantised height * heightDecode.y
 
 out vec3 fragmentColor;
 // out vec2 UV;
 
 void main(){
-	gl_Position = MVP * vec4(vertexPosition_modelspace, 1);
+	vec3 position = vertexPosition_modelspace;
+	if (packedVertices) {
+		ivec2 grid = gridOrigin + ivec2(packedVertex.xy);
+		float h = float(packedVertex.z + packedVertex.w * 256u);
+		position = vec3(grid.y * spacing, heightDecode.x + h * heightDecode.y, grid.x * spacing);
+	}
+	gl_Position = MVP * vec4(position, 1);
 	// fragmentColor = vertexColor;
 	//fragmentColor.x = vertexPosition_modelspace[1]/20;
 	//fragmentColor.y = 0;
 	//fragmentColor.z = 255 - fragmentColor.x;
-	fragmentColor = vec3(vertexPosition_modelspace[1]*300/255, 0, 1 - vertexPosition_modelspace[1]*300/255);
+	fragmentColor = vec3(position[1]*300/255, 0, 1 - position[1]*300/255);
 }
\ No newline at end of file